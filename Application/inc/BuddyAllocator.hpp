@@ -1,142 +1,263 @@
 #pragma once
-#include <memory>
-#include <vector>
-#include <array>
-#include <bitset>
-#include <math.h>
+#include <iostream>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 
-class BuddyAllocator
+#include "VirtualMemory.hpp"
+
+// Classic binary buddy allocator.
+// Blocks of order k are m_minimumSize << k bytes. All state lives in a flat implicit tree (node i has children
+// 2i + 1 and 2i + 2): one byte per node holding the order of the largest free block in its subtree, and one bit
+// per node marking allocated blocks. Offsets and sizes follow from the node index, and the blocks themselves are
+// never written to, so untouched parts of the arena are never backed by memory.
+template <size_t ArenaSize = 4096 * 1024, size_t MinBlockSize = 32 * 1024>
+class BasicBuddyAllocator
 {
 private:
-	struct Block
+	static_assert(std::has_single_bit(ArenaSize) && std::has_single_bit(MinBlockSize), "Sizes must be powers of two");
+	static_assert(ArenaSize >= MinBlockSize, "The arena must hold at least one block");
+
+	static constexpr size_t m_minimumSize = MinBlockSize;
+	static constexpr size_t m_numRows = std::countr_zero(ArenaSize) - std::countr_zero(MinBlockSize);
+	static constexpr size_t m_numBlocks = ((size_t)2 << m_numRows) - 1;
+	static constexpr size_t BITMAP_WORDS = (m_numBlocks + 63) / 64;
+
+	char* m_memory = nullptr;
+
+	// Per node, how many orders the largest free block in its subtree is short of the whole block.
+	// A whole free block stores 0, so the tree starts out in freshly mapped, untouched pages.
+	MemoryInternal::VirtualArray<uint8_t> m_longestFree;
+	MemoryInternal::VirtualArray<uint64_t> m_allocatedBlocks;
+
+	size_t m_freeBytes = 0;
+
+	static constexpr size_t BlockSize(size_t order)
 	{
-		bool isFree = true;
-		size_t size = 0;
-		size_t offset = 0;
+		return m_minimumSize << order;
+	}
 
-		Block* left = nullptr;
-		Block* right = nullptr;
-		Block* parent = nullptr;
-	};
+	static constexpr size_t FirstNodeOfOrder(size_t order)
+	{
+		return ((size_t)1 << (m_numRows - order)) - 1;
+	}
 
-	std::unique_ptr<std::array<char, 4096 * 1024>> m_memory;
-	size_t m_minimumSize = 32 * 1024;
+	// Index of the tree node of the given order that starts at 'offset'
+	static constexpr size_t NodeIndex(size_t offset, size_t order)
+	{
+		return FirstNodeOfOrder(order) + offset / BlockSize(order);
+	}
 
-	size_t m_numRows = (size_t)(log2(4096 * 1024) - log2(m_minimumSize));
-	size_t m_numBlocks = (size_t)pow(2, m_numRows + 1) - 1;
+	// 1 + the order of the largest free block in the subtree of 'node', 0 if it has none
+	size_t Longest(size_t node, size_t order) const
+	{
+		return order + 1 - m_longestFree[node];
+	}
 
-	std::unique_ptr<std::vector<Block>> m_blocks;
+	void SetLongest(size_t node, size_t order, size_t longest)
+	{
+		m_longestFree[node] = (uint8_t)(order + 1 - longest);
+	}
 
-	Block* FindBlock(Block* block, size_t size, int parentIndex)
+	bool IsAllocated(size_t node) const
 	{
-		// If the block we are checking is free, and if the data could fit in the block
-		if (block->isFree && block->size >= size)
-		{
-			// There are no child blocks
-			if (block->left == nullptr && block->right == nullptr)
-			{
-				// If the half size of the block is larger than the minimum,
-				// and the data can fit in the half size
-				if (block->size / 2 >= m_minimumSize && block->size / 2 >= size)
-				{
-					block->left = &m_blocks.get()->at((2 * parentIndex) + 1);
-					block->right = &m_blocks.get()->at(2 * (parentIndex + 1));
-
-					block->left->size = block->size / 2;
-					block->right->size = block->size / 2;
-
-					block->left->offset = block->offset;
-					block->right->offset = block->offset + block->left->size;
-
-					block->left->parent = block->right->parent = block;
-				}
-				// Either the half block would hit the minimum, or the data would not fit so we stop
-				else
-				{
-					block->isFree = false;
-					return block;
-				}
+		return (m_allocatedBlocks[node / 64] >> (node % 64)) & 1;
+	}
 
-			}
-			Block* left = FindBlock(block->left, size, (2 * parentIndex) + 1);
-			if (left != nullptr)
-			{
-				return left;
-			}
-			return FindBlock(block->right, size, 2 * (parentIndex + 1));
-		}
+	void SetAllocated(size_t node, bool allocated)
+	{
+		if (allocated)
+			m_allocatedBlocks[node / 64] |= 1ULL << (node % 64);
 		else
+			m_allocatedBlocks[node / 64] &= ~(1ULL << (node % 64));
+	}
+
+	// Recomputes the ancestors of 'node' after its subtree changed, stopping once a value stays the same
+	void UpdateParents(size_t node, size_t order)
+	{
+		while (node > 0)
 		{
-			return nullptr;
+			node = (node - 1) / 2;
+			order++;
+
+			size_t left = Longest(2 * node + 1, order - 1);
+			size_t right = Longest(2 * node + 2, order - 1);
+
+			// Two whole free buddies merge into one free block
+			size_t longest = (left == order && right == order) ? order + 1 : (left > right ? left : right);
+
+			if (Longest(node, order) == longest)
+				break;
+
+			SetLongest(node, order, longest);
 		}
 	}
 
-	Block* FindBlockByOffset(Block* block, size_t offset)
+public:
+	BasicBuddyAllocator()
 	{
-		if (block->left == nullptr || block->right == nullptr)
-		{
-			if (block->offset == offset)
-				return block;
+		// Leaves the allocator empty, so every Alloc fails, when the arena can't be mapped
+		if (!m_longestFree.Reserve(m_numBlocks) || !m_longestFree.Commit(m_numBlocks))
+			return;
 
-			return nullptr;
+		if (!m_allocatedBlocks.Reserve(BITMAP_WORDS) || !m_allocatedBlocks.Commit(BITMAP_WORDS))
+			return;
+
+		m_memory = (char*)MemoryInternal::VirtualMemory::Reserve(ArenaSize);
+		if (m_memory == nullptr)
+			return;
+
+		if (!MemoryInternal::VirtualMemory::Commit(m_memory, ArenaSize))
+		{
+			MemoryInternal::VirtualMemory::Release(m_memory, ArenaSize);
+			m_memory = nullptr;
+			return;
 		}
 
-		if (block->right->offset > offset)
-			return FindBlockByOffset(block->left, offset);
+		// Zeroed metadata already describes one free block of the highest order
+		m_freeBytes = ArenaSize;
+	}
 
-		return FindBlockByOffset(block->right, offset);
+	~BasicBuddyAllocator()
+	{
+		if (m_memory != nullptr)
+			MemoryInternal::VirtualMemory::Release(m_memory, ArenaSize);
 	}
 
-public:
-	BuddyAllocator()
+	BasicBuddyAllocator(const BasicBuddyAllocator&) = delete;
+	BasicBuddyAllocator& operator=(const BasicBuddyAllocator&) = delete;
+
+	static constexpr size_t GetArenaSize()
 	{
-		m_memory = std::make_unique<std::array<char, 4096 * 1024>>();
-		m_blocks = std::make_unique<std::vector<Block>>();
-		m_blocks.get()->resize(m_numBlocks);
-		//Do we need this resize? We need to keep the blocks at constant memory places, so yes?
-		// Change this to reserve.
-		//m_blocks.reserve((1024 * 1000) / m_minimumSize);
-		//m_blocks[0].size = 1024 * 1000;
+		return ArenaSize;
+	}
 
-		m_blocks.get()->at(0).size = 4096 * 1024;
-		//m_blocks.push_back(baseBlock);
+	static constexpr size_t GetMinimumBlockSize()
+	{
+		return MinBlockSize;
+	}
+
+	// Start of the arena, nullptr if it couldn't be mapped
+	char* GetBase() const
+	{
+		return m_memory;
 	}
 
-	
 	void* Alloc(size_t size)
 	{
-		Block* allocated = FindBlock(&m_blocks.get()->at(0), size, 0);
-		if (allocated == nullptr)
-		{
+		if (size == 0 || size > ArenaSize || m_memory == nullptr)
 			return nullptr;
+
+		// Smallest order that fits the data
+		size_t order = size <= m_minimumSize ? 0 : std::bit_width(size - 1) - std::countr_zero(m_minimumSize);
+
+		if (Longest(0, m_numRows) < order + 1)
+			return nullptr;
+
+		// Descend towards the tightest subtree that still has a large enough free block
+		size_t node = 0;
+		size_t nodeOrder = m_numRows;
+
+		while (nodeOrder > order)
+		{
+			// A whole free block splits down to its leftmost descendant of the wanted order
+			if (m_longestFree[node] == 0)
+			{
+				node = ((node + 1) << (nodeOrder - order)) - 1;
+				break;
+			}
+
+			nodeOrder--;
+
+			size_t left = Longest(2 * node + 1, nodeOrder);
+			size_t right = Longest(2 * node + 2, nodeOrder);
+
+			bool useLeft = left > order && (right <= order || left <= right);
+			node = 2 * node + (useLeft ? 1 : 2);
 		}
 
-		return m_memory.get()->data() + allocated->offset;
+		SetAllocated(node, true);
+		SetLongest(node, order, 0);
+		UpdateParents(node, order);
+
+		m_freeBytes -= BlockSize(order);
+
+		return m_memory + (node - FirstNodeOfOrder(order)) * BlockSize(order);
 	}
 
 	void Free(void* mem)
 	{
-		ptrdiff_t offset = (char*)mem - m_memory.get()->data();
-		Block* block = FindBlockByOffset(&m_blocks.get()->at(0), offset);
+		if (mem == nullptr || m_memory == nullptr)
+			return;
+
+		ptrdiff_t signedOffset = (char*)mem - m_memory;
+		if (signedOffset < 0 || (size_t)signedOffset >= ArenaSize || (size_t)signedOffset % m_minimumSize != 0)
+			return;
 
-		block->isFree = true;
-		Block* parent = block->parent;
-		
-		if (parent->left->isFree && parent->right->isFree)
+		size_t offset = (size_t)signedOffset;
+
+		// Walk up from the smallest block at the offset to the one that was allocated
+		size_t order = 0;
+		size_t node = NodeIndex(offset, 0);
+
+		while (!IsAllocated(node))
 		{
-			parent->left = nullptr;
-			parent->right = nullptr;
+			if (order == m_numRows)
+				return; // Not inside an allocated block
+
+			node = (node - 1) / 2;
+			order++;
 		}
 
+		if (offset % BlockSize(order) != 0)
+			return; // Not the start of an allocated block
+
+		SetAllocated(node, false);
+		SetLongest(node, order, order + 1);
+		UpdateParents(node, order);
+
+		m_freeBytes += BlockSize(order);
+	}
+
+	size_t GetFreeBytes() const
+	{
+		return m_freeBytes;
+	}
+
+	// Size of the largest request that can currently succeed
+	size_t GetLargestFreeBlock() const
+	{
+		if (m_memory == nullptr)
+			return 0;
+
+		size_t longest = Longest(0, m_numRows);
+		return longest == 0 ? 0 : BlockSize(longest - 1);
+	}
+
+	// 0 when all free memory is in one block, approaching 1 as it is split into ever smaller blocks
+	float GetFragmentation() const
+	{
+		if (m_freeBytes == 0)
+			return 0.0f;
+
+		return 1.0f - (float)GetLargestFreeBlock() / (float)m_freeBytes;
+	}
+
+	// Bytes of the block tree, its pages are only backed once touched
+	static constexpr size_t GetMetadataBytes()
+	{
+		return m_numBlocks * sizeof(uint8_t) + BITMAP_WORDS * sizeof(uint64_t);
 	}
 
 	void PrintAllocatedIndices()
 	{
-		for (size_t i = 0; i < m_blocks.get()->size(); i++)
+		for (size_t i = 0; i < m_numBlocks; i++)
 		{
-			if (!m_blocks.get()->at(i).isFree)
+			if (IsAllocated(i))
 				std::cout << i << '\n';
 		}
 		std::cout << std::endl;
 	}
-};
\ No newline at end of file
+};
+
+using BuddyAllocator = BasicBuddyAllocator<>;
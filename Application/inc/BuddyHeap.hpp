@@ -0,0 +1,183 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "BuddyAllocator.hpp"
+
+// Buddy allocator that maps another arena whenever the existing ones can't serve a request, and unmaps arenas
+// that become fully free again, keeping one spare so a heap hovering around an arena boundary doesn't remap it
+// on every call. Arenas are tried in the order they were mapped, so later ones drain first.
+// Requests larger than one arena fail.
+template <size_t ArenaSize = 4096 * 1024, size_t MinBlockSize = 32 * 1024>
+class BasicBuddyHeap
+{
+private:
+	using Arena = BasicBuddyAllocator<ArenaSize, MinBlockSize>;
+
+	static constexpr size_t NO_ARENA = SIZE_MAX;
+
+	struct AddressEntry
+	{
+		char* base;
+		size_t arenaIndex;
+	};
+
+	std::vector<std::unique_ptr<Arena>> m_arenas;
+	std::vector<uint8_t> m_largestFreeOrder; // Per arena, 1 + the order of its largest free block, 0 if it has none
+	std::vector<AddressEntry> m_arenasByAddress; // Sorted by base address, to find the arena of a pointer
+
+	size_t m_spareArena = NO_ARENA; // The one fully free arena kept mapped
+	size_t m_peakArenaCount = 0;
+
+	static uint8_t OrderOf(size_t blockSize)
+	{
+		return blockSize == 0 ? 0 : (uint8_t)(std::countr_zero(blockSize) - std::countr_zero(MinBlockSize) + 1);
+	}
+
+	void UpdateSummary(size_t arenaIndex)
+	{
+		m_largestFreeOrder[arenaIndex] = OrderOf(m_arenas[arenaIndex]->GetLargestFreeBlock());
+	}
+
+	// nullptr if the OS is out of address space or memory
+	Arena* MapArena()
+	{
+		std::unique_ptr<Arena> arena = std::make_unique<Arena>();
+		if (arena->GetBase() == nullptr)
+			return nullptr;
+
+		Arena* result = arena.get();
+
+		auto position = std::upper_bound(m_arenasByAddress.begin(), m_arenasByAddress.end(), result->GetBase(),
+			[](const char* base, const AddressEntry& entry) { return base < entry.base; });
+		m_arenasByAddress.insert(position, { result->GetBase(), m_arenas.size() });
+
+		m_arenas.push_back(std::move(arena));
+		m_largestFreeOrder.push_back(OrderOf(ArenaSize));
+
+		m_peakArenaCount = std::max(m_peakArenaCount, m_arenas.size());
+
+		return result;
+	}
+
+	// Later arenas move down one index, rare enough with a spare arena kept mapped to fix them up one by one
+	void UnmapArena(size_t arenaIndex)
+	{
+		char* base = m_arenas[arenaIndex]->GetBase();
+
+		m_arenasByAddress.erase(std::find_if(m_arenasByAddress.begin(), m_arenasByAddress.end(),
+			[base](const AddressEntry& entry) { return entry.base == base; }));
+
+		for (AddressEntry& entry : m_arenasByAddress)
+		{
+			if (entry.arenaIndex > arenaIndex)
+				entry.arenaIndex--;
+		}
+
+		if (m_spareArena != NO_ARENA && m_spareArena > arenaIndex)
+			m_spareArena--;
+
+		m_largestFreeOrder.erase(m_largestFreeOrder.begin() + arenaIndex);
+		m_arenas.erase(m_arenas.begin() + arenaIndex);
+	}
+
+public:
+	BasicBuddyHeap() = default;
+
+	BasicBuddyHeap(const BasicBuddyHeap&) = delete;
+	BasicBuddyHeap& operator=(const BasicBuddyHeap&) = delete;
+
+	static constexpr size_t GetArenaSize()
+	{
+		return ArenaSize;
+	}
+
+	void* Alloc(size_t size)
+	{
+		if (size == 0 || size > ArenaSize)
+			return nullptr;
+
+		uint8_t neededOrder = OrderOf(std::max(MinBlockSize, std::bit_ceil(size)));
+
+		for (size_t i = 0; i < m_arenas.size(); i++)
+		{
+			// Skips arenas without a large enough block without touching them
+			if (m_largestFreeOrder[i] < neededOrder)
+				continue;
+
+			void* mem = m_arenas[i]->Alloc(size);
+			UpdateSummary(i);
+
+			if (i == m_spareArena)
+				m_spareArena = NO_ARENA;
+
+			return mem;
+		}
+
+		Arena* arena = MapArena();
+		if (arena == nullptr)
+			return nullptr;
+
+		void* mem = arena->Alloc(size);
+		UpdateSummary(m_arenas.size() - 1);
+
+		return mem;
+	}
+
+	void Free(void* mem)
+	{
+		if (mem == nullptr)
+			return;
+
+		// Last arena starting at or before the pointer
+		auto position = std::upper_bound(m_arenasByAddress.begin(), m_arenasByAddress.end(), (char*)mem,
+			[](const char* address, const AddressEntry& entry) { return address < entry.base; });
+
+		if (position == m_arenasByAddress.begin())
+			return;
+
+		const AddressEntry& entry = *(position - 1);
+		if ((char*)mem >= entry.base + ArenaSize)
+			return; // Not in any arena
+
+		size_t arenaIndex = entry.arenaIndex;
+		Arena& arena = *m_arenas[arenaIndex];
+
+		arena.Free(mem);
+		UpdateSummary(arenaIndex);
+
+		if (arena.GetFreeBytes() != ArenaSize || arenaIndex == m_spareArena)
+			return;
+
+		// The first arena to become fully free is kept as the spare, any further ones are unmapped
+		if (m_spareArena == NO_ARENA)
+			m_spareArena = arenaIndex;
+		else
+			UnmapArena(arenaIndex);
+	}
+
+	size_t GetArenaCount() const
+	{
+		return m_arenas.size();
+	}
+
+	size_t GetPeakArenaCount() const
+	{
+		return m_peakArenaCount;
+	}
+
+	size_t GetFreeBytes() const
+	{
+		size_t freeBytes = 0;
+		for (const std::unique_ptr<Arena>& arena : m_arenas)
+			freeBytes += arena->GetFreeBytes();
+
+		return freeBytes;
+	}
+};
+
+using BuddyHeap = BasicBuddyHeap<>;
@@ -0,0 +1,227 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include "StackAllocator.hpp"
+
+// Stack allocator that chains another chunk instead of failing when the current one is full.
+// Chunks released by Reset go to a small pool that later overflows take from first. Reset keeps a single chunk
+// large enough for the frame that just ended, so a steady workload settles on one chunk and never chains,
+// and releases pooled chunks larger than that one, so a one-off spike doesn't stay reserved.
+class ChainedStackAllocator
+{
+private:
+	struct Chunk
+	{
+		char* data = nullptr;
+		size_t size = 0;
+	};
+
+	std::vector<Chunk> m_chunks; // Chunks in use this frame, the last one is being allocated from
+	std::vector<Chunk> m_pooledChunks;
+
+	size_t m_top = 0; // Within the last chunk
+	size_t m_chunkSize;
+	size_t m_maxPooledChunks;
+
+	size_t m_frameBytes = 0;
+	size_t m_lastFramePeak = 0;
+
+	static Chunk CreateChunk(size_t size)
+	{
+		Chunk chunk;
+		chunk.data = (char*)operator new(size, std::align_val_t(STACK_ALIGNMENT), std::nothrow);
+		chunk.size = chunk.data != nullptr ? size : 0;
+
+		return chunk;
+	}
+
+	static void DestroyChunk(Chunk& chunk)
+	{
+		operator delete(chunk.data, std::align_val_t(STACK_ALIGNMENT));
+		chunk = {};
+	}
+
+	// Makes a chunk of at least 'size' bytes current, preferring the smallest pooled one that fits
+	bool ChainChunk(size_t size)
+	{
+		auto best = m_pooledChunks.end();
+		for (auto it = m_pooledChunks.begin(); it != m_pooledChunks.end(); ++it)
+		{
+			if (it->size >= size && (best == m_pooledChunks.end() || it->size < best->size))
+				best = it;
+		}
+
+		Chunk chunk;
+		if (best != m_pooledChunks.end())
+		{
+			chunk = *best;
+			m_pooledChunks.erase(best);
+		}
+		else
+		{
+			chunk = CreateChunk(std::max(m_chunkSize, std::bit_ceil(size)));
+			if (chunk.data == nullptr)
+				return false;
+		}
+
+		m_chunks.push_back(chunk);
+		m_top = 0;
+
+		return true;
+	}
+
+public:
+	// 'chunkSize' is the size of the first chunk and the smallest one chained on overflow
+	explicit ChainedStackAllocator(size_t chunkSize = STACK_SIZE, size_t maxPooledChunks = 4)
+		: m_chunkSize(chunkSize), m_maxPooledChunks(maxPooledChunks)
+	{
+		ChainChunk(m_chunkSize);
+	}
+
+	~ChainedStackAllocator()
+	{
+		for (Chunk& chunk : m_chunks)
+			DestroyChunk(chunk);
+
+		for (Chunk& chunk : m_pooledChunks)
+			DestroyChunk(chunk);
+	}
+
+	ChainedStackAllocator(const ChainedStackAllocator&) = delete;
+	ChainedStackAllocator& operator=(const ChainedStackAllocator&) = delete;
+
+	// Reserves uninitialized space, chaining a new chunk if the current one is full. 'align' must be a power of two.
+	// Returns nullptr only if a new chunk can't be allocated.
+	void* Allocate(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		if (!m_chunks.empty())
+		{
+			Chunk& chunk = m_chunks.back();
+			size_t padding = (0 - (uintptr_t)(chunk.data + m_top)) & (align - 1);
+
+			if (padding <= chunk.size - m_top && size <= chunk.size - m_top - padding)
+			{
+				void* mem = chunk.data + m_top + padding;
+
+				m_top += padding + size;
+				m_frameBytes += padding + size;
+
+				return mem;
+			}
+		}
+
+		// Chunks are aligned to STACK_ALIGNMENT, only larger alignments need room for padding
+		size_t padding = align > STACK_ALIGNMENT ? align - STACK_ALIGNMENT : 0;
+		if (!ChainChunk(size + padding))
+			return nullptr;
+
+		return Allocate(size, align);
+	}
+
+	// Copies 'size' bytes on top of the stack, aligned to 'align', a power of two. Raw bytes are packed by default.
+	// Returns where they were copied to, or nullptr if a new chunk can't be allocated.
+	void* Push(const void* data, size_t size, size_t align = 1)
+	{
+		void* mem = Allocate(size, align);
+		if (mem == nullptr)
+			return nullptr;
+
+		memcpy(mem, data, size);
+
+		return mem;
+	}
+
+	// Copies 'value' on top of the stack, aligned for T
+	template <typename T>
+	T* Push(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Push copies bytes, use Emplace for other types");
+
+		return (T*)Push(&value, sizeof(T), alignof(T));
+	}
+
+	template <typename T, typename... Args>
+	T* Emplace(Args&&... args)
+	{
+		void* mem = Allocate(sizeof(T), alignof(T));
+		if (mem == nullptr)
+			return nullptr;
+
+		return new (mem) T(std::forward<Args>(args)...);
+	}
+
+	// Ends the frame: keeps one chunk large enough for everything the frame allocated, pools the smaller others
+	// and releases the largest ones beyond the pool limit
+	void Reset()
+	{
+		m_lastFramePeak = m_frameBytes;
+		m_frameBytes = 0;
+
+		m_pooledChunks.insert(m_pooledChunks.end(), m_chunks.begin(), m_chunks.end());
+		m_chunks.clear();
+
+		ChainChunk(std::max(m_chunkSize, m_lastFramePeak));
+
+		// Chunks beyond the kept one were only needed by an earlier, larger frame
+		size_t keptSize = m_chunks.empty() ? m_chunkSize : m_chunks.back().size;
+		for (Chunk& chunk : m_pooledChunks)
+		{
+			if (chunk.size > keptSize)
+				DestroyChunk(chunk);
+		}
+
+		m_pooledChunks.erase(std::remove_if(m_pooledChunks.begin(), m_pooledChunks.end(),
+			[](const Chunk& chunk) { return chunk.data == nullptr; }), m_pooledChunks.end());
+
+		while (m_pooledChunks.size() > m_maxPooledChunks)
+		{
+			auto largest = std::max_element(m_pooledChunks.begin(), m_pooledChunks.end(),
+				[](const Chunk& a, const Chunk& b) { return a.size < b.size; });
+
+			DestroyChunk(*largest);
+			m_pooledChunks.erase(largest);
+		}
+	}
+
+	// Bytes allocated since the last Reset, padding included
+	size_t GetFrameBytes()
+	{
+		return m_frameBytes;
+	}
+
+	// Bytes the previous frame allocated, a single chunk of this size would have held it
+	size_t GetLastFramePeak()
+	{
+		return m_lastFramePeak;
+	}
+
+	size_t GetChunkCount()
+	{
+		return m_chunks.size();
+	}
+
+	size_t GetPooledChunkCount()
+	{
+		return m_pooledChunks.size();
+	}
+
+	// Bytes held in chunks, in use or pooled
+	size_t GetReservedBytes()
+	{
+		size_t bytes = 0;
+		for (const Chunk& chunk : m_chunks)
+			bytes += chunk.size;
+
+		for (const Chunk& chunk : m_pooledChunks)
+			bytes += chunk.size;
+
+		return bytes;
+	}
+};
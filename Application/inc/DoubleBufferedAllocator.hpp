@@ -0,0 +1,51 @@
+#pragma once
+#include <new>
+#include <utility>
+
+#include "StackAllocator.hpp"
+
+// Frame allocator whose memory survives one extra frame: data allocated in frame N stays valid until the
+// SwapBuffers call that starts frame N + 2, so results can be handed from one frame to the next.
+class DoubleBufferedAllocator
+{
+private:
+	StackAllocator m_stacks[2];
+	size_t m_current = 0;
+
+public:
+	// Call once per frame, makes the older buffer current and clears it
+	void SwapBuffers()
+	{
+		m_current ^= 1;
+		m_stacks[m_current].Reset();
+	}
+
+	// Reserves uninitialized space in the current buffer, 'align' must be a power of two.
+	// Returns nullptr if it doesn't fit.
+	void* Allocate(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		return m_stacks[m_current].Allocate(size, align);
+	}
+
+	template <typename T, typename... Args>
+	T* Emplace(Args&&... args)
+	{
+		return m_stacks[m_current].Emplace<T>(std::forward<Args>(args)...);
+	}
+
+	StackAllocator& GetCurrentBuffer()
+	{
+		return m_stacks[m_current];
+	}
+
+	StackAllocator& GetPreviousBuffer()
+	{
+		return m_stacks[m_current ^ 1];
+	}
+
+	void Reset()
+	{
+		m_stacks[0].Reset();
+		m_stacks[1].Reset();
+	}
+};
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "StackAllocator.hpp"
+
+// Two stacks sharing one block: long-lived data grows up from the bottom, transient data grows down from the top,
+// and either side can use whatever the other leaves free.
+class DoubleEndedStackAllocator
+{
+private:
+	StorageType m_stack;
+	size_t m_bottom = 0; // End of the bottom stack
+	size_t m_top = STACK_SIZE; // Start of the top stack
+
+public:
+	DoubleEndedStackAllocator()
+	{
+		m_stack = std::make_unique<AlignedStackStorage>();
+		*(m_stack.get()) = {};
+	}
+
+	// Reserves uninitialized space on the bottom stack, 'align' must be a power of two.
+	// Returns nullptr if it doesn't fit.
+	void* AllocateBottom(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		size_t padding = (0 - (uintptr_t)(m_stack.get()->data() + m_bottom)) & (align - 1);
+
+		if (padding > m_top - m_bottom || size > m_top - m_bottom - padding)
+			return nullptr;
+
+		void* mem = m_stack.get()->data() + m_bottom + padding;
+		m_bottom += padding + size;
+
+		return mem;
+	}
+
+	// Reserves uninitialized space on the top stack, 'align' must be a power of two.
+	// Returns nullptr if it doesn't fit.
+	void* AllocateTop(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		if (size > m_top - m_bottom)
+			return nullptr;
+
+		char* start = m_stack.get()->data() + m_top - size;
+		size_t padding = (uintptr_t)start & (align - 1);
+
+		if (padding > m_top - m_bottom - size)
+			return nullptr;
+
+		m_top -= size + padding;
+
+		return m_stack.get()->data() + m_top;
+	}
+
+	template <typename T, typename... Args>
+	T* EmplaceBottom(Args&&... args)
+	{
+		void* mem = AllocateBottom(sizeof(T), alignof(T));
+		if (mem == nullptr)
+			return nullptr;
+
+		return new (mem) T(std::forward<Args>(args)...);
+	}
+
+	template <typename T, typename... Args>
+	T* EmplaceTop(Args&&... args)
+	{
+		void* mem = AllocateTop(sizeof(T), alignof(T));
+		if (mem == nullptr)
+			return nullptr;
+
+		return new (mem) T(std::forward<Args>(args)...);
+	}
+
+	size_t GetBottomMarker()
+	{
+		return m_bottom;
+	}
+
+	size_t GetTopMarker()
+	{
+		return m_top;
+	}
+
+	// Releases everything allocated on the bottom since 'marker' was taken, stale markers are ignored
+	void FreeBottomToMarker(size_t marker)
+	{
+		if (marker <= m_bottom)
+			m_bottom = marker;
+	}
+
+	// Releases everything allocated on the top since 'marker' was taken, stale markers are ignored
+	void FreeTopToMarker(size_t marker)
+	{
+		if (marker >= m_top && marker <= STACK_SIZE)
+			m_top = marker;
+	}
+
+	void ResetBottom()
+	{
+		m_bottom = 0;
+	}
+
+	void ResetTop()
+	{
+		m_top = STACK_SIZE;
+	}
+
+	void Reset()
+	{
+		ResetBottom();
+		ResetTop();
+	}
+
+	size_t DBG_GetBottom()
+	{
+		return m_bottom;
+	}
+
+	size_t DBG_GetTop()
+	{
+		return m_top;
+	}
+
+	constexpr size_t DBG_GetMaxSize()
+	{
+		return STACK_SIZE;
+	}
+};
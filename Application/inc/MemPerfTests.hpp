@@ -3,4 +3,19 @@
 namespace PerfTests
 {
 	void RunPoolPerfTests();
+	void RunFreeLatencyTests();
+	void RunThreadScalingTests();
+	void RunDecommitTests();
+	void RunMetadataOverheadTests();
+	void RunReallocTests();
+	void RunBatchTests();
+	void RunPlacementPolicyTests();
+	void RunCompactionTests();
+	void RunBuddyTests();
+	void RunBuddyChurnTests();
+	void RunSlabTests();
+	void RunBuddyHeapTests();
+	void RunStackTests();
+	void RunFrameAllocatorTests();
+	void RunChainedStackTests();
 }
\ No newline at end of file
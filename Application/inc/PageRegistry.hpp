@@ -3,292 +3,2347 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <memory>
 #include <unordered_map>
 #include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <span>
+#include <type_traits>
 
 #include "TracyClient/public/tracy/Tracy.hpp"
 
+#include "VirtualMemory.hpp"
+
 namespace MemoryInternal
 {
 	constexpr size_t NULL_INDEX = static_cast<size_t>(-1);
 
 	constexpr size_t DEFAULT_PAGE_SIZE = (1 << 13);
 
+	// Address space reserved per registry for its storage, pages are committed into it as it grows
+	constexpr size_t DEFAULT_RESERVE_BYTES = (1ull << 32);
+
+	constexpr size_t DEFAULT_LINK_RESERVE = 64;
+
+	// Free regions that have stayed untouched for DEFAULT_DECOMMIT_IDLE_FREES calls to Free
+	// hand the physical memory of their whole OS pages back, if that is at least DEFAULT_DECOMMIT_MIN_BYTES
+	constexpr size_t DEFAULT_DECOMMIT_MIN_BYTES = (1 << 16);
+	constexpr size_t DEFAULT_DECOMMIT_IDLE_FREES = (1 << 10);
+
+	// In concurrent mode each thread caches freed spans of up to MAGAZINE_MAX_COUNT elements,
+	// rounded up to a power of two, in one magazine per size. Empty magazines are refilled
+	// and full ones drained in batches of MAGAZINE_BATCH_COUNT spans under the registry lock.
+	// The rounding is internal, allocations still report the count they were made with.
+	constexpr size_t MAGAZINE_MAX_COUNT = (1 << 8);
+	constexpr size_t MAGAZINE_CLASS_COUNT = 9; // One per power of two up to MAGAZINE_MAX_COUNT
+	constexpr size_t MAGAZINE_CAPACITY = 16;
+	constexpr size_t MAGAZINE_BATCH_COUNT = MAGAZINE_CAPACITY / 2;
+
+	// Allocation counts are kept in a sparse table keyed by the first element of each allocation.
+	// In concurrent mode, where the table needs the lock, allocations also mark their first element
+	// in a bitmap, and those of up to MAGAZINE_MAX_COUNT elements mark their last element in a second
+	// bitmap instead of using the table, so threads can read their count without the lock.
+	// Spans sitting in a thread cache keep their end bit but not their start bit, so they read as unallocated.
+	constexpr size_t BITMAP_WORD_BITS = 64;
+
+	// Free regions are binned by size in a two-level index (TLSF-style).
+	// The first level is the power of two of the size, the second level splits
+	// each power of two linearly into SIZE_CLASS_SUBDIV_COUNT sub-classes.
+	constexpr size_t SIZE_CLASS_SUBDIV_LOG2 = 4;
+	constexpr size_t SIZE_CLASS_SUBDIV_COUNT = (1 << SIZE_CLASS_SUBDIV_LOG2);
+	constexpr size_t SIZE_CLASS_COUNT = 48; // Enough for counts up to 2^51
+
 	struct AllocLink
 	{
 		size_t offset;
 		size_t size;
-		size_t next;
+		size_t left;   // Free region subtree with lower offsets
+		size_t right;  // Free region subtree with higher offsets
+		size_t height; // Height of the subtree rooted at this region
+		size_t maxSize; // Largest region in the subtree, only kept up to date for address-ordered placement
+
+		size_t binNext; // Next free region in the same size class
+		size_t binPrev; // Previous free region in the same size class
 
-		AllocLink() : offset(0), size(0), next(NULL_INDEX) { }
+		size_t idleSince; // Free count when the region was last grown
+		bool decommitted; // Whether its whole OS pages have been handed back
+
+		AllocLink()
+			: offset(0), size(0), left(NULL_INDEX), right(NULL_INDEX), height(1), maxSize(0), binNext(NULL_INDEX), binPrev(NULL_INDEX), idleSince(0), decommitted(false) { }
 		AllocLink(size_t off, size_t sz)
-			: offset(off), size(sz), next(NULL_INDEX) { }
+			: offset(off), size(sz), left(NULL_INDEX), right(NULL_INDEX), height(1), maxSize(sz), binNext(NULL_INDEX), binPrev(NULL_INDEX), idleSince(0), decommitted(false) { }
+	};
+
+	// Open addressing map from the offset of an allocation to its element count.
+	// Linear probing with backward shift deletion, so erased entries leave no tombstones behind.
+	class SpanCountTable
+	{
+	public:
+		// Returns the count stored for 'offset', or 0 if there is none
+		[[nodiscard]] size_t Find(size_t offset) const
+		{
+			if (m_size == 0)
+				return 0;
+
+			for (size_t slot = Home(offset); m_entries[slot].offset != NULL_INDEX; slot = (slot + 1) & m_mask)
+			{
+				if (m_entries[slot].offset == offset)
+					return m_entries[slot].count;
+			}
+
+			return 0;
+		}
+
+		void Set(size_t offset, size_t count)
+		{
+			// Keep a quarter of the slots empty so probe sequences stay short
+			if ((m_size + 1) * 4 > m_entries.size() * 3)
+				Rehash(std::max(MIN_CAPACITY, m_entries.size() * 2));
+
+			size_t slot = Home(offset);
+			while (m_entries[slot].offset != NULL_INDEX && m_entries[slot].offset != offset)
+				slot = (slot + 1) & m_mask;
+
+			if (m_entries[slot].offset == NULL_INDEX)
+				++m_size;
+
+			m_entries[slot] = { offset, count };
+		}
+
+		void Erase(size_t offset)
+		{
+			if (m_size == 0)
+				return;
+
+			size_t slot = Home(offset);
+			while (m_entries[slot].offset != offset)
+			{
+				if (m_entries[slot].offset == NULL_INDEX)
+					return; // Not found
+
+				slot = (slot + 1) & m_mask;
+			}
+
+			--m_size;
+
+			// Pull later entries of the probe sequence back into the gap
+			for (size_t next = (slot + 1) & m_mask; m_entries[next].offset != NULL_INDEX; next = (next + 1) & m_mask)
+			{
+				size_t home = Home(m_entries[next].offset);
+
+				// Entries whose home lies cyclically in (slot, next] can't move before it
+				bool stays = (slot <= next) ? (slot < home && home <= next) : (slot < home || home <= next);
+				if (stays)
+					continue;
+
+				m_entries[slot] = m_entries[next];
+				slot = next;
+			}
+
+			m_entries[slot] = {};
+		}
+
+		void Clear()
+		{
+			m_entries.clear();
+			m_entries.shrink_to_fit();
+			m_size = 0;
+			m_mask = 0;
+			m_shift = 0;
+		}
+
+		[[nodiscard]] size_t CapacityBytes() const
+		{
+			return m_entries.capacity() * sizeof(Entry);
+		}
+
+	private:
+		static constexpr size_t MIN_CAPACITY = 64;
+
+		struct Entry
+		{
+			size_t offset = NULL_INDEX;
+			size_t count = 0;
+		};
+
+		std::vector<Entry> m_entries; // Power of two sized
+		size_t m_size = 0;
+		size_t m_mask = 0;
+		size_t m_shift = 0;
+
+		[[nodiscard]] size_t Home(size_t offset) const
+		{
+			// Fibonacci hashing, neighbouring offsets land far apart
+			return static_cast<size_t>((static_cast<uint64_t>(offset) * 0x9E3779B97F4A7C15ull) >> m_shift) & m_mask;
+		}
+
+		void Rehash(size_t capacity)
+		{
+			std::vector<Entry> entries(capacity);
+			entries.swap(m_entries);
+
+			m_mask = capacity - 1;
+			m_shift = 64 - std::countr_zero(capacity);
+
+			for (const Entry &entry : entries)
+			{
+				if (entry.offset == NULL_INDEX)
+					continue;
+
+				size_t slot = Home(entry.offset);
+				while (m_entries[slot].offset != NULL_INDEX)
+					slot = (slot + 1) & m_mask;
+
+				m_entries[slot] = entry;
+			}
+		}
+	};
+
+	struct SizeClass
+	{
+		size_t first;
+		size_t second;
+	};
+
+	// Maps a size to the class whose range contains it.
+	[[nodiscard]] constexpr SizeClass MapSizeClass(size_t size)
+	{
+		if (size < SIZE_CLASS_SUBDIV_COUNT)
+			return { 0, size };
+
+		size_t log2 = std::bit_width(size) - 1;
+		size_t shift = log2 - SIZE_CLASS_SUBDIV_LOG2;
+
+		return { shift + 1, (size >> shift) - SIZE_CLASS_SUBDIV_COUNT };
+	}
+
+	// Rounds a size up to the next class boundary.
+	[[nodiscard]] constexpr size_t RoundUpToSizeClass(size_t size)
+	{
+		if (size < SIZE_CLASS_SUBDIV_COUNT)
+			return size;
+
+		size_t mask = (static_cast<size_t>(1) << (std::bit_width(size) - 1 - SIZE_CLASS_SUBDIV_LOG2)) - 1;
+		return (size + mask) & ~mask;
+	}
+
+	// Maps a size to the lowest class whose regions are all at least that large.
+	[[nodiscard]] constexpr SizeClass MapSizeClassRoundUp(size_t size)
+	{
+		return MapSizeClass(RoundUpToSizeClass(size));
+	}
+
+	// How a registry picks the free region an allocation is carved from
+	enum class PlacementPolicy
+	{
+		GoodFit,  // Lowest addressed region of the smallest size class guaranteed to fit, scans one size class
+		BestFit,  // Smallest region that fits, scans one or two size classes
+		FirstFit, // Lowest addressed region that fits
+		NextFit,  // First region that fits after the previous allocation, wrapping around
 	};
 
+	// Specialize to choose the placement policy used by Alloc<T> and friends.
 	template <typename T>
+	struct PlacementOf : std::integral_constant<PlacementPolicy, PlacementPolicy::GoodFit> { };
+
+	// Storage for one element of any type with the given size and alignment
+	template <size_t Size, size_t Align, PlacementPolicy Policy>
+	struct alignas(Align) RawSlot
+	{
+		std::byte bytes[Size];
+	};
+
+	// Types that can live in raw bytes share one registry per size, alignment and placement policy,
+	// so their capacity is pooled. Specialize to std::false_type to give a type a registry of its own.
+	template <typename T>
+	struct SharesRegistry : std::bool_constant<std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>> { };
+
+	template <typename T, PlacementPolicy Policy = PlacementOf<T>::value>
+	using RegistrySlot = std::conditional_t<SharesRegistry<T>::value, RawSlot<sizeof(T), alignof(T), Policy>, T>;
+
+	template <typename T, PlacementPolicy Policy = PlacementOf<T>::value>
+	class Handle;
+
+	// PageRegistry<T> forwards to the registry of its slot type. For shared types, resetting or
+	// initializing it affects every type of the same size, alignment and placement policy.
+	template <typename T, PlacementPolicy Policy = PlacementOf<T>::value>
 	class PageRegistry
 	{
+		template <typename, PlacementPolicy> friend class PageRegistry;
+
+		using Shared = PageRegistry<RegistrySlot<T, Policy>, Policy>;
+		using Slot = RegistrySlot<T, Policy>;
+
+		// First and next fit search the free region tree by the largest region in each subtree
+		static constexpr bool ADDRESS_ORDERED_FIT = (Policy == PlacementPolicy::FirstFit || Policy == PlacementPolicy::NextFit);
+
 	public:
-		static int Initialize(size_t maxCount)
+		// Storage starts out as one page of 'pageSize' elements and grows by whole pages when full,
+		// up to 'reserveBytes' of address space. Pointers stay valid as the registry grows.
+		// A concurrent registry must be initialized explicitly before any thread uses it.
+		static int Initialize(size_t pageSize, bool concurrent = false, size_t reserveBytes = DEFAULT_RESERVE_BYTES)
 		{
-			PageRegistry<T> &registry = Get();
+			Shared &registry = Get();
 
 			if (registry.m_initialized)
 				return -1; // Failure: Already initialized
 
-			if (maxCount <= 0)
-				return -2; // Failure: Invalid max count
+			if (pageSize <= 0)
+				return -2; // Failure: Invalid page size
 
-			if ((maxCount & (maxCount - 1)) != 0)
-				return -3; // Failure: Max count must be a power of two
+			if ((pageSize & (pageSize - 1)) != 0)
+				return -3; // Failure: Page size must be a power of two
 
-			registry.m_pageStorage.resize(maxCount);
-			registry.m_allocMap.resize(maxCount);
-			registry.m_freeRegionLinkStorage.resize(maxCount);
+			// Whole pages only
+			size_t reservedCount = (reserveBytes / sizeof(T)) & ~(pageSize - 1);
 
-			registry.m_maxCount = maxCount;
-			registry.m_initialized = true;
-			registry.m_freeRegionsRoot = 0;
+			if (reservedCount == 0)
+				return -4; // Failure: Reservation too small for a single page
+
+			// Raw storage, objects are only constructed once allocated
+			size_t reservedWords = (reservedCount + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+			if (!registry.m_pageStorage.Reserve(reservedCount) ||
+				!registry.m_allocStarts.Reserve(reservedWords) ||
+				!registry.m_allocEnds.Reserve(reservedWords) ||
+				!registry.m_allocMovable.Reserve(reservedWords) ||
+				!registry.m_allocPadded.Reserve(reservedWords) ||
+				!registry.m_allocConstructed.Reserve(reservedWords))
+			{
+				registry.ReleaseStorage();
+				return -5; // Failure: Could not reserve address space
+			}
 
-			std::fill(registry.m_allocMap.begin(), registry.m_allocMap.end(), NULL_INDEX);
-			std::fill(registry.m_freeRegionLinkStorage.begin(), registry.m_freeRegionLinkStorage.end(), AllocLink(0, 0));
+			registry.m_freeRegionLinkStorage.clear();
+			registry.m_freeRegionLinkStorage.reserve(DEFAULT_LINK_RESERVE);
+			registry.m_unusedLinksHead = NULL_INDEX;
+			registry.m_freeRegionsRoot = NULL_INDEX;
+			registry.m_nextFitOffset = 0;
+			registry.m_compactOffset = 0;
+			registry.m_handles.clear();
+			registry.m_freeHandlesHead = NULL_INDEX;
+			registry.m_handleOffsets.clear();
+
+			registry.m_firstLevelMask = 0;
+			registry.m_secondLevelMasks.fill(0);
+			for (auto &bins : registry.m_bins)
+				bins.fill(NULL_INDEX);
+
+			registry.m_pageSize = pageSize;
+			registry.m_osPageSize = VirtualMemory::GetPageSize();
+			registry.m_reservedCount = reservedCount;
+			registry.m_freeCount = 0;
+			registry.m_decommittedBytes = 0;
+			registry.m_decommittedPages.clear();
+			registry.m_committedCount.store(0, std::memory_order_relaxed);
+			registry.m_concurrent = concurrent;
+
+			if (!registry.Grow(pageSize))
+			{
+				registry.ReleaseStorage();
+				registry.m_concurrent = false;
+				return -6; // Failure: Could not commit the first page
+			}
 
-			registry.m_freeRegionLinkStorage[0] = AllocLink(0, maxCount);
+			registry.m_generation.fetch_add(1, std::memory_order_relaxed);
+			registry.m_initialized = true;
 
 			return 0; // Success
 		}
 		static void Reset()
 		{
-			PageRegistry<T> &registry = Get();
-			registry.m_pageStorage.clear();
+			Shared &registry = Get();
+			registry.ReleaseStorage();
 			registry.m_freeRegionLinkStorage.clear();
-			registry.m_allocMap.clear();
-			registry.m_freeRegionsRoot = 0;
+			registry.m_freeRegionLinkStorage.shrink_to_fit();
+			registry.m_freeRegionsRoot = NULL_INDEX;
+			registry.m_nextFitOffset = 0;
+			registry.m_compactOffset = 0;
+			registry.m_handles.clear();
+			registry.m_handles.shrink_to_fit();
+			registry.m_freeHandlesHead = NULL_INDEX;
+			std::unordered_map<size_t, size_t>().swap(registry.m_handleOffsets); // clear() keeps the buckets
+			registry.m_unusedLinksHead = NULL_INDEX;
+			registry.m_decommittedPages.clear();
+			registry.m_decommittedPages.shrink_to_fit();
+			registry.m_firstLevelMask = 0;
+			registry.m_secondLevelMasks.fill(0);
 			registry.m_initialized = false;
-			registry.m_maxCount = 0;
+			registry.m_concurrent = false;
+			registry.m_pageSize = 0;
+			registry.m_reservedCount = 0;
+			registry.m_committedCount.store(0, std::memory_order_relaxed);
+
+			// Invalidates the spans held in every thread cache
+			registry.m_generation.fetch_add(1, std::memory_order_relaxed);
 		}
 
+		// Returns uninitialized storage for 'count' elements, see New() for constructing them
 		[[nodiscard]] static T *Alloc(size_t count)
 		{
-			PageRegistry<T> &registry = Get();
+			Shared &registry = Get();
 
 			if (!registry.m_initialized)
 				Initialize(DEFAULT_PAGE_SIZE); // Default max count
 
-			if (count == 0 || count > registry.m_maxCount)
+			if (count == 0 || count > registry.m_reservedCount)
 				return nullptr; // Failure: Invalid count
 
-			// Find first free region of sufficient size
-			size_t prev = NULL_INDEX;
-			size_t current = registry.m_freeRegionsRoot;
+			size_t allocOffset = registry.m_concurrent ? registry.AllocCached(count) : registry.AllocRegion(count);
 
-			auto &freeRegions = registry.m_freeRegionLinkStorage;
+			if (allocOffset == NULL_INDEX)
+				return nullptr; // Failure: No sufficient free region
 
-			while (current != NULL_INDEX)
-			{
-				if (freeRegions[current].size >= count)
-				{
-					size_t allocOffset = freeRegions[current].offset;
+			T *ptr = reinterpret_cast<T *>(&registry.m_pageStorage[allocOffset]);
 
-					// Update free region
-					freeRegions[current].offset += count;
-					freeRegions[current].size -= count;
+			// Register allocation in tracy
+			TracyAlloc(ptr, count * sizeof(T));
 
-					// Remove the link if no space left
-					if (freeRegions[current].size == 0)
-					{
-						if (prev != NULL_INDEX)
-						{
-							freeRegions[prev].next = freeRegions[current].next;
-						}
-						else
-						{
-							// Update head of free regions
-							registry.m_freeRegionsRoot = freeRegions[current].next;
-						}
-
-						freeRegions[current] = AllocLink(0, 0); // Mark as unused
-					}
+			return ptr;
+		}
+		// Returns uninitialized storage for 'count' elements whose address is a multiple of 'alignment'.
+		// The alignment must be a power of two no larger than the OS page size.
+		[[nodiscard]] static T *AllocAligned(size_t count, size_t alignment)
+		{
+			if (alignment <= alignof(T))
+				return Alloc(count);
 
-					// Add to alloc map
-					registry.m_allocMap[allocOffset] = count;
+			Shared &registry = Get();
 
-					// Register allocation in tracy
-					TracyAlloc(&registry.m_pageStorage[allocOffset], count * sizeof(T));
+			if (!registry.m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Default max count
 
-					return &registry.m_pageStorage[allocOffset];
-				}
+			if (!std::has_single_bit(alignment) || alignment > registry.m_osPageSize)
+				return nullptr; // Failure: Invalid alignment
+
+			// The storage is page aligned, so every 'step' elements share the same alignment
+			size_t step = alignment / std::gcd(sizeof(T), alignment);
+
+			if (count == 0 || count + step - 1 > registry.m_reservedCount)
+				return nullptr; // Failure: Invalid count
+
+			size_t allocOffset;
 
-				prev = current;
-				current = freeRegions[current].next;
+			if (registry.m_concurrent)
+			{
+				// Aligned spans bypass the thread caches, which only hold unaligned ones
+				std::lock_guard<std::mutex> lock(registry.m_mutex);
+				allocOffset = registry.AllocRegion(count, step);
+			}
+			else
+			{
+				allocOffset = registry.AllocRegion(count, step);
 			}
 
-			return nullptr; // Failure: No sufficient free region
+			if (allocOffset == NULL_INDEX)
+				return nullptr; // Failure: No sufficient free region
+
+			T *ptr = reinterpret_cast<T *>(&registry.m_pageStorage[allocOffset]);
+
+			// Register allocation in tracy
+			TracyAlloc(ptr, count * sizeof(T));
+
+			return ptr;
 		}
+
+		// Returns storage to the registry without destroying its elements, see Delete() for destroying them
 		static int Free(T *ptr)
 		{
-			PageRegistry<T> &registry = Get();
+			Shared &registry = Get();
 			if (!registry.m_initialized || ptr == nullptr)
 				return -1;
 
-			size_t offset = ptr - registry.m_pageStorage.data();
+			size_t offset = reinterpret_cast<const Slot *>(ptr) - registry.m_pageStorage.Data();
 
-			if (offset >= registry.m_maxCount)
+			if (offset >= registry.m_committedCount.load(std::memory_order_acquire))
 				return -2; // Failure: Invalid pointer
 
-			size_t count = registry.m_allocMap[offset];
-			if (count == NULL_INDEX)
+			size_t count = registry.GetCountUnlocked(offset);
+			if (count == 0)
 				return -3; // Failure: Not allocated
 
+			if (registry.m_handlesUsed.load(std::memory_order_relaxed) && registry.TestBit(registry.m_allocMovable, offset))
+				return -4; // Failure: Relocatable allocations are freed through their handle
+
 			// Unregister allocation in tracy
 			TracyFree(ptr);
 
-			// Remove from alloc map
-			registry.m_allocMap[offset] = NULL_INDEX;
-
-			auto &freeRegions = registry.m_freeRegionLinkStorage;
+			registry.ClearConstructed(offset);
 
-			// Handle case where pool is full
-			if (registry.m_freeRegionsRoot == NULL_INDEX)
-			{
-				// Add this allocation as the only free region
-				size_t newLinkIndex = registry.FindFreeRegion();
-				registry.m_freeRegionsRoot = newLinkIndex;
-				freeRegions[newLinkIndex] = AllocLink(offset, count);
-			}
+			if (registry.m_concurrent)
+				registry.FreeCached(offset, count);
 			else
+				registry.FreeRegion(offset, count);
+
+			return 0; // Success
+		}
+
+		// Grows or shrinks an allocation without moving it, see Realloc() for constructing and destroying elements.
+		// Shrinking always succeeds, growing needs enough free space right after the allocation.
+		static int Resize(T *ptr, size_t newCount)
+		{
+			Shared &registry = Get();
+			if (!registry.m_initialized || ptr == nullptr)
+				return -1;
+
+			size_t offset = reinterpret_cast<const Slot *>(ptr) - registry.m_pageStorage.Data();
+
+			if (offset >= registry.m_committedCount.load(std::memory_order_acquire))
+				return -2; // Failure: Invalid pointer
+
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
+
+			size_t count = registry.GetCount(offset);
+			if (count == 0)
+				return -3; // Failure: Not allocated
+
+			if (newCount == 0 || newCount > registry.m_reservedCount - offset)
+				return -4; // Failure: Invalid count
+
+			registry.ReleasePadding(offset, count);
+
+			if (!registry.ResizeRegion(offset, count, newCount))
+				return -5; // Failure: No room to grow in place
+
+			// Re-register allocation in tracy
+			TracyFree(ptr);
+			TracyAlloc(ptr, newCount * sizeof(T));
+
+			return 0; // Success
+		}
+
+		// Allocates up to 'n' spans of 'count' elements into 'out', carving as many as fit from each free region.
+		// Returns the number of spans allocated, the remaining entries of 'out' are set to nullptr.
+		static size_t AllocBatch(size_t count, size_t n, T **out)
+		{
+			Shared &registry = Get();
+
+			if (!registry.m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Default max count
+
+			if (out == nullptr)
+				return 0;
+
+			std::fill_n(out, n, nullptr);
+
+			if (count == 0 || count > registry.m_reservedCount)
+				return 0; // Failure: Invalid count
+
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
+
+			size_t allocated = 0;
+
+			while (allocated < n)
 			{
-				// Find correct position to insert freed region
-				// such that the insertion point falls after 'left' and before 'right'
-				size_t left = NULL_INDEX;
-				size_t right = registry.m_freeRegionsRoot;
+				size_t offset = NULL_INDEX;
+				size_t spans = registry.AllocRegionBatch(count, n - allocated, offset);
+				if (spans == 0)
+					break;
 
-				while (right != NULL_INDEX)
+				for (size_t i = 0; i < spans; ++i)
 				{
-					if (offset < freeRegions[right].offset)
-						break;
+					T *ptr = reinterpret_cast<T *>(&registry.m_pageStorage[offset + i * count]);
 
-					left = right;
-					right = freeRegions[right].next;
+					// Register allocation in tracy
+					TracyAlloc(ptr, count * sizeof(T));
+
+					out[allocated++] = ptr;
 				}
+			}
 
-				// If regions are contiguous, merge them instead of creating a new link
-				if (left != NULL_INDEX && (freeRegions[left].offset + freeRegions[left].size == offset))
-				{
-					freeRegions[left].size += count;
+			return allocated;
+		}
 
-					if (right && (offset + count == freeRegions[right].offset))
-					{
-						// Merge with next region as well
-						freeRegions[left].size += freeRegions[right].size;
-						freeRegions[left].next = freeRegions[right].next;
+		// Frees every allocation in 'ptrs', merging neighbouring ones before returning them to the free regions.
+		// Returns the number of allocations freed, invalid and duplicate pointers are skipped.
+		static size_t FreeBatch(T *const *ptrs, size_t n)
+		{
+			Shared &registry = Get();
+			if (!registry.m_initialized || ptrs == nullptr)
+				return 0;
 
-						freeRegions[right] = AllocLink(0, 0); // Mark as unused
-					}
-				}
-				else if (right != NULL_INDEX && (offset + count == freeRegions[right].offset))
-				{
-					// Merge with next region
-					freeRegions[right].offset = offset;
-					freeRegions[right].size += count;
-				}
-				else // Region is not contiguous with either side, insert new link
-				{
-					// Insert new free region
-					size_t newLinkIndex = registry.FindFreeRegion();
-					freeRegions[newLinkIndex] = AllocLink(offset, count);
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
 
-					if (right != NULL_INDEX && left == NULL_INDEX)
-					{
-						// Inserting at head
-						freeRegions[newLinkIndex].next = registry.m_freeRegionsRoot;
-						registry.m_freeRegionsRoot = newLinkIndex;
-					}
-					else if (left != NULL_INDEX)
-					{
-						// Inserting in middle or end
-						freeRegions[newLinkIndex].next = freeRegions[left].next;
-						freeRegions[left].next = newLinkIndex;
-					}
-				}
+			auto &offsets = registry.m_batchOffsets;
+			offsets.clear();
+
+			size_t committedCount = registry.m_committedCount.load(std::memory_order_acquire);
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (ptrs[i] == nullptr)
+					continue;
+
+				size_t offset = reinterpret_cast<const Slot *>(ptrs[i]) - registry.m_pageStorage.Data();
+				if (offset < committedCount)
+					offsets.push_back(offset);
 			}
 
-			return 0; // Success
+			std::sort(offsets.begin(), offsets.end());
+			offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+			return registry.FreeRegionBatch(offsets);
 		}
 
-		const static std::vector<T> &DBG_GetPageStorage()
+		// Free regions qualify for decommitting once they have at least 'minBytes' of whole OS pages
+		// and have not grown for 'idleFrees' calls to Free. Qualifying regions are decommitted every
+		// 'idleFrees' frees, or only by ReleaseIdlePages if 'idleFrees' is 0.
+		// On Linux decommitted pages leave the resident set right away. On Windows they are only reset,
+		// the working set shrinks once the OS reclaims them under memory pressure.
+		static void SetDecommitPolicy(size_t minBytes, size_t idleFrees)
 		{
-			if (!Get().m_initialized)
-				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+			Shared &registry = Get();
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
 
-			return Get().m_pageStorage;
+			registry.m_decommitMinBytes = minBytes;
+			registry.m_decommitIdleFrees = idleFrees;
 		}
-		const static std::vector<AllocLink> &DBG_GetFreeRegions()
+
+		// Decommits every qualifying free region now, returns the number of bytes handed back that
+		// were not already decommitted
+		static size_t ReleaseIdlePages()
 		{
-			if (!Get().m_initialized)
-				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+			Shared &registry = Get();
+			if (!registry.m_initialized)
+				return 0;
 
-			return Get().m_freeRegionLinkStorage;
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
+
+			return registry.DecommitIdleRegions();
 		}
-		const static size_t DBG_GetFreeRegionRoot()
+
+		// Returns the number of elements in the allocation starting at 'ptr', or 0 if it is not one
+		[[nodiscard]] static size_t GetAllocatedCount(const T *ptr)
 		{
-			if (!Get().m_initialized)
-				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+			Shared &registry = Get();
+			if (!registry.m_initialized || ptr == nullptr)
+				return 0;
 
-			return Get().m_freeRegionsRoot;
+			size_t offset = reinterpret_cast<const Slot *>(ptr) - registry.m_pageStorage.Data();
+			if (offset >= registry.m_committedCount.load(std::memory_order_acquire))
+				return 0;
+
+			return registry.GetCountUnlocked(offset);
 		}
-		const static std::vector<size_t> &DBG_GetAllocMap()
+
+		// Records that the elements of the allocation at 'ptr' were constructed, so Reset destroys them if they leak.
+		// Called by New() and the other constructing functions, storage handed out by Alloc is never destroyed.
+		static void MarkConstructed(const T *ptr)
 		{
-			if (!Get().m_initialized)
-				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+			if constexpr (!std::is_trivially_destructible_v<Slot>)
+			{
+				Shared &registry = Get();
+				registry.SetBit(registry.m_allocConstructed, reinterpret_cast<const Slot *>(ptr) - registry.m_pageStorage.Data());
+			}
+		}
+
+		// Returns the bytes used to track allocations and free regions
+		[[nodiscard]] static size_t GetMetadataBytes()
+		{
+			Shared &registry = Get();
 
-			return Get().m_allocMap;
+			return registry.m_allocStarts.CommittedBytes() + registry.m_allocEnds.CommittedBytes() + registry.m_spanCounts.CapacityBytes() +
+				registry.m_allocMovable.CommittedBytes() + registry.m_allocPadded.CommittedBytes() +
+				registry.m_allocConstructed.CommittedBytes() + registry.m_handles.capacity() * sizeof(HandleEntry) +
+				registry.m_handleOffsets.bucket_count() * sizeof(void *) + registry.m_handleOffsets.size() * HANDLE_NODE_BYTES +
+				registry.m_freeRegionLinkStorage.capacity() * sizeof(AllocLink) + registry.m_decommittedPages.capacity() * sizeof(uint64_t) +
+				sizeof(registry.m_secondLevelMasks) + sizeof(registry.m_bins);
 		}
 
-	private:
-		std::vector<AllocLink> m_freeRegionLinkStorage;
+		// Returns the bytes of storage currently committed for elements
+		[[nodiscard]] static size_t GetCommittedBytes()
+		{
+			return Get().m_pageStorage.CommittedBytes();
+		}
+
+		// Returns a handle to uninitialized storage for 'count' elements that Compact may relocate.
+		// Handles must be freed with FreeHandle, pointers resolved from them are only valid until the next Compact.
+		[[nodiscard]] static Handle<T, Policy> AllocHandle(size_t count)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be relocated");
 
-		std::vector<T> m_pageStorage;
-		std::vector<size_t> m_allocMap; // Offset to size mapping
-		size_t m_freeRegionsRoot = NULL_INDEX;
+			Shared &registry = Get();
 
-		bool m_initialized = false;
-		size_t m_maxCount = 0;
+			if (!registry.m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Default max count
 
+			if (count == 0 || count > registry.m_reservedCount)
+				return {}; // Failure: Invalid count
 
-		PageRegistry() = default;
-		~PageRegistry() = default;
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
+
+			if (!registry.m_handlesUsed.load(std::memory_order_relaxed))
+			{
+				size_t committedWords = (registry.m_committedCount.load(std::memory_order_relaxed) + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+				if (!registry.m_allocMovable.Commit(committedWords))
+					return {}; // Failure: Could not commit the relocation bitmap
+
+				registry.m_handlesUsed.store(true, std::memory_order_relaxed);
+			}
+
+			// Relocatable spans bypass the thread caches
+			size_t offset = registry.AllocRegion(count);
+
+			if (offset == NULL_INDEX)
+				return {}; // Failure: No sufficient free region
+
+			registry.SetBit(registry.m_allocMovable, offset);
 
-		[[nodiscard]] static PageRegistry<T> &Get()
+			// Register allocation in tracy
+			TracyAlloc(&registry.m_pageStorage[offset], count * sizeof(T));
+
+			size_t index = registry.AcquireHandle(offset);
+			return Handle<T, Policy>(index, registry.m_handles[index].generation);
+		}
+
+		// Returns the current address of a handle's allocation, or nullptr if the handle is not live
+		[[nodiscard]] static T *Resolve(Handle<T, Policy> handle)
 		{
-			static PageRegistry<T> instance;
-			return instance;
+			Shared &registry = Get();
+
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
+
+			size_t offset = registry.GetHandleOffset(handle.m_index, handle.m_generation);
+			if (offset == NULL_INDEX)
+				return nullptr;
+
+			return reinterpret_cast<T *>(&registry.m_pageStorage[offset]);
 		}
 
-		[[nodiscard]] size_t FindFreeRegion()
+		static int FreeHandle(Handle<T, Policy> handle)
 		{
-			// Look through free region links to find first with size of 0, meaning unused
-			for (size_t i = 0; i < m_freeRegionLinkStorage.size(); ++i)
-			{
-				if (m_freeRegionLinkStorage[i].size == 0)
-					return i;
-			}
+			Shared &registry = Get();
+			if (!registry.m_initialized)
+				return -1;
+
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
+
+			size_t offset = registry.GetHandleOffset(handle.m_index, handle.m_generation);
+			if (offset == NULL_INDEX)
+				return -2; // Failure: Invalid or freed handle
 
-			// No free link found
-			return NULL_INDEX;
+			// Unregister allocation in tracy
+			TracyFree(&registry.m_pageStorage[offset]);
+
+			registry.ReleaseHandle(handle.m_index);
+			registry.ClearBit(registry.m_allocMovable, offset);
+			registry.FreeRegion(offset, registry.GetCount(offset));
+
+			return 0; // Success
 		}
-	};
 
-	template <typename T>
-	[[nodiscard]] inline T *Alloc(size_t count)
-	{
-		return PageRegistry<T>::Alloc(count);
-	}
+		// Slides relocatable allocations toward lower offsets into the free regions before them,
+		// merging those regions with the ones after. Pinned allocations made by Alloc stay in place.
+		// Stops once 'budgetMicroseconds' have passed, the next call resumes where this one stopped.
+		// Returns the number of elements moved.
+		static size_t Compact(size_t budgetMicroseconds)
+		{
+			Shared &registry = Get();
+			if (!registry.m_initialized)
+				return 0;
 
-	template <typename T>
-	inline int Free(T *ptr)
-	{
-		return PageRegistry<T>::Free(ptr);
+			std::unique_lock<std::mutex> lock(registry.m_mutex, std::defer_lock);
+			if (registry.m_concurrent)
+				lock.lock();
+
+			return registry.CompactRegions(std::chrono::steady_clock::now() + std::chrono::microseconds(budgetMicroseconds));
+		}
+
+		// Returns the spans cached by the calling thread to the shared registry.
+		// Called automatically when the thread exits.
+		static void FlushThreadCache()
+		{
+			Get().FlushThreadCache(GetThreadCache());
+		}
+
+		static std::span<T> DBG_GetPageStorage()
+		{
+			if (!Get().m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+
+			return std::span<T>(reinterpret_cast<T *>(Get().m_pageStorage.Data()), Get().m_committedCount.load());
+		}
+		const static std::vector<AllocLink> &DBG_GetFreeRegions()
+		{
+			if (!Get().m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+
+			return Get().m_freeRegionLinkStorage;
+		}
+		const static size_t DBG_GetFreeRegionRoot()
+		{
+			if (!Get().m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+
+			return Get().m_freeRegionsRoot;
+		}
+		static std::vector<AllocLink> DBG_GetOrderedFreeRegions()
+		{
+			if (!Get().m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+
+			std::vector<AllocLink> regions;
+			Get().CollectInOrder(Get().m_freeRegionsRoot, regions);
+			return regions;
+		}
+		static size_t DBG_GetDecommittedBytes()
+		{
+			return Get().m_decommittedBytes;
+		}
+		static size_t DBG_GetReservedCount()
+		{
+			if (!Get().m_initialized)
+				Initialize(DEFAULT_PAGE_SIZE); // Ensure initialized for debugging
+
+			return Get().m_reservedCount;
+		}
+
+	private:
+		std::vector<AllocLink> m_freeRegionLinkStorage;
+		size_t m_unusedLinksHead = NULL_INDEX; // Stack of unused links, chained through 'binNext'
+
+		VirtualArray<T> m_pageStorage; // Uninitialized storage, committed up to m_committedCount elements
+		VirtualArray<uint64_t> m_allocStarts; // Bit per element, set on the first element of each allocation.
+		                                      // Only committed in concurrent mode.
+		VirtualArray<uint64_t> m_allocEnds; // Bit per element, set on the last element of allocations of up to
+		                                    // MAGAZINE_MAX_COUNT elements. Only committed in concurrent mode.
+		SpanCountTable m_spanCounts; // Count of every allocation without an end bit, keyed by its offset.
+		                             // Guarded by the lock in concurrent mode.
+		VirtualArray<uint64_t> m_allocMovable; // Bit per element, set on the first element of relocatable allocations.
+		                                       // Only committed once handles are used.
+		VirtualArray<uint64_t> m_allocPadded; // Bit per element, set on the first element of allocations served from a
+		                                      // larger magazine span. Only committed in concurrent mode.
+		VirtualArray<uint64_t> m_allocConstructed; // Bit per element, set on the first element of allocations made by New().
+		                                           // Only committed for types with a destructor.
+		std::atomic<bool> m_handlesUsed = false;
+		size_t m_freeRegionsRoot = NULL_INDEX; // Root of the address-ordered AVL tree of free regions
+		size_t m_nextFitOffset = 0; // Where the next fit search resumes, the end of the previous allocation
+
+		// Size-class index over the free regions
+		uint64_t m_firstLevelMask = 0;
+		std::array<uint32_t, SIZE_CLASS_COUNT> m_secondLevelMasks{};
+		std::array<std::array<size_t, SIZE_CLASS_SUBDIV_COUNT>, SIZE_CLASS_COUNT> m_bins{};
+
+		bool m_initialized = false;
+		size_t m_pageSize = 0;
+		size_t m_reservedCount = 0;
+		std::atomic<size_t> m_committedCount = 0; // Read without the lock to validate pointers
+
+		// Decommit policy
+		size_t m_osPageSize = 0;
+		size_t m_decommitMinBytes = DEFAULT_DECOMMIT_MIN_BYTES;
+		size_t m_decommitIdleFrees = DEFAULT_DECOMMIT_IDLE_FREES;
+		size_t m_freeCount = 0; // Clock for how long free regions have been idle
+		size_t m_decommittedBytes = 0; // Total bytes handed back, for profiling
+		std::vector<uint64_t> m_decommittedPages; // Bit per OS page of the storage, set while it is decommitted
+
+		std::vector<size_t> m_batchOffsets; // Scratch space for sorting the offsets passed to FreeBatch
+
+		// Indirection table for relocatable allocations
+		struct HandleEntry
+		{
+			size_t offset; // NULL_INDEX while the entry is unused
+			size_t generation; // Bumped when the entry is freed, invalidating old handles
+			size_t nextFree; // Next unused entry
+		};
+
+		std::vector<HandleEntry> m_handles;
+		size_t m_freeHandlesHead = NULL_INDEX;
+		std::unordered_map<size_t, size_t> m_handleOffsets; // Offset of every relocatable allocation to its handle
+		static constexpr size_t HANDLE_NODE_BYTES = sizeof(std::pair<const size_t, size_t>) + sizeof(void *); // Estimated map node, key and value plus the chain link
+		size_t m_compactOffset = 0; // Where the next Compact call resumes
+
+		// Concurrent mode
+		bool m_concurrent = false;
+		std::mutex m_mutex; // Guards everything except allocation bits owned by the calling thread
+		std::atomic<uint64_t> m_generation = 0; // Bumped on Initialize and Reset to invalidate thread caches
+
+		struct ThreadCache
+		{
+			uint64_t generation = 0;
+			std::array<size_t, MAGAZINE_CLASS_COUNT> counts{};
+			std::array<std::array<size_t, MAGAZINE_CAPACITY>, MAGAZINE_CLASS_COUNT> offsets{};
+
+			~ThreadCache()
+			{
+				Get().FlushThreadCache(*this);
+			}
+		};
+
+
+		PageRegistry() = default;
+		~PageRegistry()
+		{
+			ReleaseStorage();
+		}
+
+		[[nodiscard]] static Shared &Get()
+		{
+			if constexpr (std::is_same_v<Shared, PageRegistry<T, Policy>>)
+			{
+				static PageRegistry<T, Policy> instance;
+				return instance;
+			}
+			else
+			{
+				return Shared::Get();
+			}
+		}
+
+		[[nodiscard]] static typename Shared::ThreadCache &GetThreadCache()
+		{
+			if constexpr (std::is_same_v<Shared, PageRegistry<T, Policy>>)
+			{
+				thread_local ThreadCache cache;
+				return cache;
+			}
+			else
+			{
+				return Shared::GetThreadCache();
+			}
+		}
+
+		// Destroys the objects New() constructed that were never deleted and releases the page storage
+		void ReleaseStorage()
+		{
+			if (m_pageStorage.Data() == nullptr)
+				m_committedCount.store(0, std::memory_order_relaxed);
+
+			if constexpr (!std::is_trivially_destructible_v<T>)
+			{
+				size_t committedWords = (m_committedCount.load(std::memory_order_relaxed) + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+				// Raw storage from Alloc and freed spans were never constructed or already destroyed
+				for (size_t word = 0; word < committedWords; ++word)
+				{
+					for (uint64_t bits = m_allocConstructed[word]; bits != 0; bits &= bits - 1)
+					{
+						size_t offset = word * BITMAP_WORD_BITS + std::countr_zero(bits);
+						std::destroy_n(m_pageStorage.Data() + offset, GetCount(offset));
+					}
+				}
+			}
+
+			m_pageStorage.Release();
+			m_allocStarts.Release();
+			m_allocEnds.Release();
+			m_allocMovable.Release();
+			m_allocPadded.Release();
+			m_allocConstructed.Release();
+			m_spanCounts.Clear();
+			m_handlesUsed.store(false, std::memory_order_relaxed);
+		}
+
+		[[nodiscard]] uint64_t LoadBits(const VirtualArray<uint64_t> &bitmap, size_t word) const
+		{
+			// Other threads may be flipping bits of neighbouring allocations in the same word
+			if (m_concurrent)
+				return std::atomic_ref<uint64_t>(const_cast<uint64_t &>(bitmap[word])).load(std::memory_order_relaxed);
+
+			return bitmap[word];
+		}
+
+		void SetBit(VirtualArray<uint64_t> &bitmap, size_t index)
+		{
+			uint64_t mask = 1ull << (index % BITMAP_WORD_BITS);
+
+			if (m_concurrent)
+				std::atomic_ref<uint64_t>(bitmap[index / BITMAP_WORD_BITS]).fetch_or(mask, std::memory_order_relaxed);
+			else
+				bitmap[index / BITMAP_WORD_BITS] |= mask;
+		}
+
+		void ClearBit(VirtualArray<uint64_t> &bitmap, size_t index)
+		{
+			uint64_t mask = 1ull << (index % BITMAP_WORD_BITS);
+
+			if (m_concurrent)
+				std::atomic_ref<uint64_t>(bitmap[index / BITMAP_WORD_BITS]).fetch_and(~mask, std::memory_order_relaxed);
+			else
+				bitmap[index / BITMAP_WORD_BITS] &= ~mask;
+		}
+
+		[[nodiscard]] bool TestBit(const VirtualArray<uint64_t> &bitmap, size_t index) const
+		{
+			return (LoadBits(bitmap, index / BITMAP_WORD_BITS) & (1ull << (index % BITMAP_WORD_BITS))) != 0;
+		}
+
+		// Returns the element count of the allocation starting at 'offset', or 0 if none starts there.
+		// In concurrent mode the caller must hold the lock, see GetCountUnlocked.
+		[[nodiscard]] size_t GetCount(size_t offset) const
+		{
+			if (!m_concurrent)
+				return m_spanCounts.Find(offset);
+
+			if (!TestBit(m_allocStarts, offset))
+				return 0;
+
+			size_t count = FindEndBit(offset);
+			return count != 0 ? count : m_spanCounts.Find(offset);
+		}
+
+		// GetCount for callers that don't hold the lock, only taken to look up long concurrent allocations
+		[[nodiscard]] size_t GetCountUnlocked(size_t offset)
+		{
+			if (!m_concurrent)
+				return GetCount(offset);
+
+			if (!TestBit(m_allocStarts, offset))
+				return 0;
+
+			size_t count = FindEndBit(offset);
+			if (count != 0)
+				return count;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return GetCount(offset);
+		}
+
+		// Returns the count of a concurrent allocation of up to MAGAZINE_MAX_COUNT elements from its end bit, or 0.
+		// Longer allocations have no end bit, and the search never leaves their own elements.
+		[[nodiscard]] size_t FindEndBit(size_t offset) const
+		{
+			size_t last = std::min(offset + MAGAZINE_MAX_COUNT, m_committedCount.load(std::memory_order_relaxed)) - 1;
+
+			size_t word = offset / BITMAP_WORD_BITS;
+			uint64_t bits = LoadBits(m_allocEnds, word) & (~0ull << (offset % BITMAP_WORD_BITS));
+
+			while (bits == 0 && word < last / BITMAP_WORD_BITS)
+				bits = LoadBits(m_allocEnds, ++word);
+
+			if (bits == 0)
+				return 0;
+
+			size_t end = word * BITMAP_WORD_BITS + std::countr_zero(bits);
+			return end <= last ? end - offset + 1 : 0;
+		}
+
+		// Records the count of the allocation at 'offset', see BITMAP_WORD_BITS for where it is kept
+		void SetCount(size_t offset, size_t count)
+		{
+			if (m_concurrent && count <= MAGAZINE_MAX_COUNT)
+				SetBit(m_allocEnds, offset + count - 1);
+			else
+				m_spanCounts.Set(offset, count);
+		}
+
+		void ClearCount(size_t offset, size_t count)
+		{
+			if (m_concurrent && count <= MAGAZINE_MAX_COUNT)
+				ClearBit(m_allocEnds, offset + count - 1);
+			else
+				m_spanCounts.Erase(offset);
+		}
+
+		void MarkAllocated(size_t offset, size_t count)
+		{
+			SetCount(offset, count);
+
+			// Set last, a thread that sees the start bit finds the count
+			if (m_concurrent)
+				SetBit(m_allocStarts, offset);
+		}
+
+		void MarkFreed(size_t offset, size_t count)
+		{
+			if (m_concurrent)
+				ClearBit(m_allocStarts, offset);
+
+			ClearCount(offset, count);
+		}
+
+		// Commits enough pages for the last free region to hold 'count' elements
+		[[nodiscard]] bool Grow(size_t count)
+		{
+			size_t committedCount = m_committedCount.load(std::memory_order_relaxed);
+
+			// A free region touching the end of the storage is extended by the new pages
+			size_t tail = m_freeRegionsRoot;
+			while (tail != NULL_INDEX && m_freeRegionLinkStorage[tail].right != NULL_INDEX)
+				tail = m_freeRegionLinkStorage[tail].right;
+
+			size_t tailSize = 0;
+			if (tail != NULL_INDEX && m_freeRegionLinkStorage[tail].offset + m_freeRegionLinkStorage[tail].size == committedCount)
+				tailSize = m_freeRegionLinkStorage[tail].size;
+
+			// The grown region must land in a size class that Alloc will search
+			size_t required = RoundUpToSizeClass(count) - std::min(tailSize, RoundUpToSizeClass(count));
+			size_t growCount = ((required + m_pageSize - 1) / m_pageSize) * m_pageSize;
+
+			if (growCount == 0 || committedCount + growCount > m_reservedCount)
+				return false;
+
+			size_t committedWords = (committedCount + growCount + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+			// Freshly committed bitmap words read as zero
+			if (!m_pageStorage.Commit(committedCount + growCount))
+				return false;
+
+			if (m_handlesUsed.load(std::memory_order_relaxed) && !m_allocMovable.Commit(committedWords))
+				return false;
+
+			if (m_concurrent && (!m_allocStarts.Commit(committedWords) || !m_allocEnds.Commit(committedWords) ||
+				!m_allocPadded.Commit(committedWords)))
+				return false;
+
+			if constexpr (!std::is_trivially_destructible_v<T>)
+			{
+				if (!m_allocConstructed.Commit(committedWords))
+					return false;
+			}
+			m_committedCount.store(committedCount + growCount, std::memory_order_release);
+
+			InsertFreeRange(committedCount, growCount);
+			return true;
+		}
+
+		// Carves 'count' elements starting at a multiple of 'step' from a free region, returns the offset or NULL_INDEX
+		[[nodiscard]] size_t AllocRegion(size_t count, size_t step = 1)
+		{
+			// Leave room for the worst case padding in front of the aligned offset
+			size_t searchCount = count + step - 1;
+
+			// Let the placement policy pick the region
+			size_t current = FindSuitableRegion(searchCount);
+
+			if (current == NULL_INDEX)
+			{
+				// Add pages until a region fits
+				if (!Grow(searchCount))
+					return NULL_INDEX;
+
+				current = FindSuitableRegion(searchCount);
+			}
+
+			auto &freeRegions = m_freeRegionLinkStorage;
+			RemoveFromBin(current);
+
+			size_t regionOffset = freeRegions[current].offset;
+			size_t allocOffset = ((regionOffset + step - 1) / step) * step;
+			size_t padding = allocOffset - regionOffset;
+
+			if (padding > 0)
+			{
+				// The region keeps the padding, whatever follows the allocation becomes a region of its own
+				size_t tailCount = freeRegions[current].size - padding - count;
+				freeRegions[current].size = padding;
+				InsertIntoBin(current);
+
+				if (tailCount > 0)
+				{
+					size_t tail = AcquireLink();
+					freeRegions[tail] = AllocLink(allocOffset + count, tailCount);
+					freeRegions[tail].idleSince = freeRegions[current].idleSince;
+					freeRegions[tail].decommitted = freeRegions[current].decommitted;
+
+					m_freeRegionsRoot = TreeInsert(m_freeRegionsRoot, tail);
+					InsertIntoBin(tail);
+				}
+			}
+			// Remove the link if no space left, otherwise shrink it and re-bin the remainder.
+			// Moving the offset up within the region keeps the address order intact.
+			else if (freeRegions[current].size == count)
+			{
+				m_freeRegionsRoot = TreeErase(m_freeRegionsRoot, allocOffset);
+				ReleaseLink(current);
+			}
+			else
+			{
+				freeRegions[current].offset += count;
+				freeRegions[current].size -= count;
+				InsertIntoBin(current);
+			}
+
+			// Mark the allocation boundaries
+			MarkAllocated(allocOffset, count);
+
+			if constexpr (Policy == PlacementPolicy::NextFit)
+				m_nextFitOffset = allocOffset + count;
+
+			return allocOffset;
+		}
+
+		// Moves the end of the allocation at 'offset' from 'count' to 'newCount' elements
+		[[nodiscard]] bool ResizeRegion(size_t offset, size_t count, size_t newCount)
+		{
+			if (newCount < count)
+			{
+				// Hand the tail back, it coalesces with any free region after it
+				ClearCount(offset, count);
+				SetCount(offset, newCount);
+
+				InsertFreeRange(offset + newCount, count - newCount);
+				return true;
+			}
+
+			size_t extra = newCount - count;
+			if (extra == 0)
+				return true;
+
+			auto &freeRegions = m_freeRegionLinkStorage;
+
+			size_t left = NULL_INDEX;
+			size_t right = NULL_INDEX;
+			FindNeighbours(offset, left, right);
+
+			bool adjacent = (right != NULL_INDEX) && (freeRegions[right].offset == offset + count);
+			size_t available = adjacent ? freeRegions[right].size : 0;
+
+			if (available < extra)
+			{
+				// Allocations at the end of the storage can grow into new pages
+				size_t end = adjacent ? freeRegions[right].offset + available : offset + count;
+				if (end != m_committedCount.load(std::memory_order_relaxed) || !Grow(extra))
+					return false;
+
+				left = NULL_INDEX;
+				right = NULL_INDEX;
+				FindNeighbours(offset, left, right);
+			}
+
+			// Take the front of the region after the allocation
+			RemoveFromBin(right);
+
+			if (freeRegions[right].size == extra)
+			{
+				m_freeRegionsRoot = TreeErase(m_freeRegionsRoot, freeRegions[right].offset);
+				ReleaseLink(right);
+			}
+			else
+			{
+				freeRegions[right].offset += extra;
+				freeRegions[right].size -= extra;
+				InsertIntoBin(right);
+			}
+
+			ClearCount(offset, count);
+			SetCount(offset, newCount);
+			return true;
+		}
+
+		// Carves up to 'n' consecutive spans of 'count' elements from one free region.
+		// Returns the number of spans, the first of which starts at 'offset'.
+		[[nodiscard]] size_t AllocRegionBatch(size_t count, size_t n, size_t &offset)
+		{
+			size_t batchCount = (n <= m_reservedCount / count) ? count * n : count;
+
+			// Prefer a region that holds the whole batch, then any region that holds a span
+			size_t current = FindSuitableRegion(batchCount);
+
+			if (current == NULL_INDEX)
+				current = FindSuitableRegion(count);
+
+			if (current == NULL_INDEX)
+			{
+				// Add pages for the whole batch if possible
+				if (!Grow(batchCount) && !Grow(count))
+					return 0;
+
+				current = FindSuitableRegion(count);
+			}
+
+			auto &freeRegions = m_freeRegionLinkStorage;
+			RemoveFromBin(current);
+
+			offset = freeRegions[current].offset;
+			size_t spans = std::min(n, freeRegions[current].size / count);
+			size_t used = spans * count;
+
+			if (freeRegions[current].size == used)
+			{
+				m_freeRegionsRoot = TreeErase(m_freeRegionsRoot, offset);
+				ReleaseLink(current);
+			}
+			else
+			{
+				freeRegions[current].offset += used;
+				freeRegions[current].size -= used;
+				InsertIntoBin(current);
+			}
+
+			for (size_t i = 0; i < spans; ++i)
+			{
+				MarkAllocated(offset + i * count, count);
+			}
+
+			if constexpr (Policy == PlacementPolicy::NextFit)
+				m_nextFitOffset = offset + used;
+
+			return spans;
+		}
+
+		// Slides relocatable allocations down into the free region before them until 'deadline' has passed,
+		// moving at least one. Returns the number of elements moved.
+		size_t CompactRegions(std::chrono::steady_clock::time_point deadline)
+		{
+			ZoneScopedC(tracy::Color::Orange);
+
+			auto &freeRegions = m_freeRegionLinkStorage;
+			size_t committedCount = m_committedCount.load(std::memory_order_relaxed);
+			size_t moved = 0;
+
+			do
+			{
+				// Start again from the beginning once every free region has been visited
+				size_t hole = FindRegionAtOrAfter(m_compactOffset);
+				if (hole == NULL_INDEX)
+				{
+					m_compactOffset = 0;
+					break;
+				}
+
+				size_t holeOffset = freeRegions[hole].offset;
+				size_t holeSize = freeRegions[hole].size;
+				size_t spanOffset = holeOffset + holeSize;
+
+				if (spanOffset >= committedCount)
+				{
+					m_compactOffset = 0;
+					break;
+				}
+
+				// Free regions are coalesced, so an allocation or a cached span follows the hole
+				auto handle = m_handleOffsets.find(spanOffset);
+				if (handle == m_handleOffsets.end())
+				{
+					// Pinned, continue with the next free region
+					m_compactOffset = spanOffset + 1;
+					continue;
+				}
+
+				size_t index = handle->second;
+				size_t count = GetCount(spanOffset);
+
+				RemoveFromBin(hole);
+				m_freeRegionsRoot = TreeErase(m_freeRegionsRoot, holeOffset);
+				ReleaseLink(hole);
+
+				// The ranges overlap when the span is larger than the hole
+				std::memmove(static_cast<void *>(&m_pageStorage[holeOffset]), static_cast<const void *>(&m_pageStorage[spanOffset]), count * sizeof(T));
+
+				// Move the allocation in tracy
+				TracyFree(&m_pageStorage[spanOffset]);
+				TracyAlloc(&m_pageStorage[holeOffset], count * sizeof(T));
+
+				MarkFreed(spanOffset, count);
+				ClearBit(m_allocMovable, spanOffset);
+				MarkAllocated(holeOffset, count);
+				SetBit(m_allocMovable, holeOffset);
+
+				m_handleOffsets.erase(handle);
+				m_handleOffsets.emplace(holeOffset, index);
+				m_handles[index].offset = holeOffset;
+
+				// The hole now follows the span, merging with any free region after it
+				InsertFreeRange(holeOffset + count, holeSize);
+
+				m_compactOffset = holeOffset + count;
+				moved += count;
+			}
+			while (std::chrono::steady_clock::now() < deadline);
+
+			return moved;
+		}
+
+		// Returns the lowest addressed free region starting at or after 'offset', or NULL_INDEX
+		[[nodiscard]] size_t FindRegionAtOrAfter(size_t offset) const
+		{
+			size_t left = NULL_INDEX;
+			size_t right = NULL_INDEX;
+			FindNeighbours(offset, left, right);
+
+			if (left != NULL_INDEX && m_freeRegionLinkStorage[left].offset == offset)
+				return left;
+
+			return right;
+		}
+
+		[[nodiscard]] size_t AcquireHandle(size_t offset)
+		{
+			size_t index = m_freeHandlesHead;
+
+			if (index != NULL_INDEX)
+			{
+				m_freeHandlesHead = m_handles[index].nextFree;
+			}
+			else
+			{
+				// New entries continue from the registry generation, so handles from before a Reset stay invalid
+				index = m_handles.size();
+				m_handles.push_back({ NULL_INDEX, m_generation.load(std::memory_order_relaxed), NULL_INDEX });
+			}
+
+			m_handles[index].offset = offset;
+			m_handleOffsets.emplace(offset, index);
+			return index;
+		}
+
+		void ReleaseHandle(size_t index)
+		{
+			HandleEntry &entry = m_handles[index];
+
+			m_handleOffsets.erase(entry.offset);
+
+			entry.offset = NULL_INDEX;
+			++entry.generation;
+			entry.nextFree = m_freeHandlesHead;
+			m_freeHandlesHead = index;
+		}
+
+		// Returns the offset of a live handle, or NULL_INDEX
+		[[nodiscard]] size_t GetHandleOffset(size_t index, size_t generation) const
+		{
+			if (index >= m_handles.size() || m_handles[index].generation != generation)
+				return NULL_INDEX;
+
+			return m_handles[index].offset;
+		}
+
+		// Frees the padding after a concurrent allocation served from a larger magazine span, so it spans exactly 'count'
+		void ReleasePadding(size_t offset, size_t count)
+		{
+			if (!m_concurrent || !TestBit(m_allocPadded, offset))
+				return;
+
+			ClearBit(m_allocPadded, offset);
+			InsertFreeRange(offset + count, std::bit_ceil(count) - count);
+		}
+
+		// Whatever is allocated at 'offset' next starts out unconstructed
+		void ClearConstructed(size_t offset)
+		{
+			if constexpr (!std::is_trivially_destructible_v<T>)
+				ClearBit(m_allocConstructed, offset);
+		}
+
+		// Returns 'count' elements at 'offset' to the free regions
+		void FreeRegion(size_t offset, size_t count)
+		{
+			// Clear the allocation boundaries
+			MarkFreed(offset, count);
+
+			++m_freeCount;
+			InsertFreeRange(offset, count);
+
+			if (m_decommitIdleFrees != 0 && (m_freeCount % m_decommitIdleFrees) == 0)
+				DecommitIdleRegions();
+		}
+
+		// Frees the allocations at the sorted, unique 'offsets', inserting each run of touching allocations
+		// as a single range. Returns the number of allocations freed.
+		size_t FreeRegionBatch(const std::vector<size_t> &offsets)
+		{
+			size_t freed = 0;
+			size_t runOffset = NULL_INDEX;
+			size_t runCount = 0;
+
+			for (size_t offset : offsets)
+			{
+				size_t count = GetCount(offset);
+				if (count == 0)
+					continue; // Not allocated
+
+				if (m_handlesUsed.load(std::memory_order_relaxed) && TestBit(m_allocMovable, offset))
+					continue; // Freed through its handle
+
+				// Unregister allocation in tracy
+				TracyFree(&m_pageStorage[offset]);
+
+				MarkFreed(offset, count);
+				ClearConstructed(offset);
+				++freed;
+
+				if (m_concurrent && TestBit(m_allocPadded, offset))
+				{
+					// The padding of a magazine span is freed along with the allocation
+					ClearBit(m_allocPadded, offset);
+					count = std::bit_ceil(count);
+				}
+
+				if (runOffset != NULL_INDEX && runOffset + runCount == offset)
+				{
+					runCount += count;
+					continue;
+				}
+
+				if (runOffset != NULL_INDEX)
+					InsertFreeRange(runOffset, runCount);
+
+				runOffset = offset;
+				runCount = count;
+			}
+
+			if (runOffset != NULL_INDEX)
+				InsertFreeRange(runOffset, runCount);
+
+			size_t previousFreeCount = m_freeCount;
+			m_freeCount += freed;
+
+			if (m_decommitIdleFrees != 0 && (m_freeCount / m_decommitIdleFrees) != (previousFreeCount / m_decommitIdleFrees))
+				DecommitIdleRegions();
+
+			return freed;
+		}
+
+		// Adds a range to the free regions, coalescing it with its neighbours
+		void InsertFreeRange(size_t offset, size_t count)
+		{
+			auto &freeRegions = m_freeRegionLinkStorage;
+
+			// Find the closest free regions on either side of the freed region
+			size_t left = NULL_INDEX;
+			size_t right = NULL_INDEX;
+			FindNeighbours(offset, left, right);
+
+			bool mergeLeft = (left != NULL_INDEX) && (freeRegions[left].offset + freeRegions[left].size == offset);
+			bool mergeRight = (right != NULL_INDEX) && (offset + count == freeRegions[right].offset);
+
+			size_t region = NULL_INDEX;
+
+			// If regions are contiguous, merge them instead of creating a new link
+			if (mergeLeft)
+			{
+				RemoveFromBin(left);
+				freeRegions[left].size += count;
+
+				if (mergeRight)
+				{
+					// Merge with next region as well
+					RemoveFromBin(right);
+					freeRegions[left].size += freeRegions[right].size;
+
+					m_freeRegionsRoot = TreeErase(m_freeRegionsRoot, freeRegions[right].offset);
+					ReleaseLink(right);
+				}
+
+				InsertIntoBin(left);
+				region = left;
+			}
+			else if (mergeRight)
+			{
+				// Merge with next region
+				RemoveFromBin(right);
+				freeRegions[right].offset = offset;
+				freeRegions[right].size += count;
+				InsertIntoBin(right);
+				region = right;
+			}
+			else // Region is not contiguous with either side, insert new link
+			{
+				size_t newLinkIndex = AcquireLink();
+				freeRegions[newLinkIndex] = AllocLink(offset, count);
+
+				m_freeRegionsRoot = TreeInsert(m_freeRegionsRoot, newLinkIndex);
+				InsertIntoBin(newLinkIndex);
+				region = newLinkIndex;
+			}
+
+			// The region now holds recently touched memory, restart its idle time
+			freeRegions[region].idleSince = m_freeCount;
+			freeRegions[region].decommitted = false;
+
+			// Any page the range touches may have been faulted back in while it was allocated
+			size_t firstPage = offset * sizeof(T) / m_osPageSize;
+			size_t lastPage = std::min(((offset + count) * sizeof(T) + m_osPageSize - 1) / m_osPageSize,
+				m_decommittedPages.size() * BITMAP_WORD_BITS);
+
+			for (size_t page = firstPage; page < lastPage; ++page)
+				m_decommittedPages[page / BITMAP_WORD_BITS] &= ~(1ull << (page % BITMAP_WORD_BITS));
+		}
+
+		// Hands back the whole OS pages of every free region that qualifies under the decommit policy
+		size_t DecommitIdleRegions()
+		{
+			ZoneScopedC(tracy::Color::Orange);
+
+			size_t decommittedBytes = 0;
+
+			for (AllocLink &region : m_freeRegionLinkStorage)
+			{
+				// Unused links have a size of 0
+				if (region.size == 0 || region.decommitted || m_freeCount - region.idleSince < m_decommitIdleFrees)
+					continue;
+
+				uintptr_t begin = reinterpret_cast<uintptr_t>(m_pageStorage.Data() + region.offset);
+				uintptr_t end = reinterpret_cast<uintptr_t>(m_pageStorage.Data() + region.offset + region.size);
+
+				// Only pages that lie entirely inside the region
+				begin = (begin + m_osPageSize - 1) & ~(m_osPageSize - 1);
+				end &= ~(m_osPageSize - 1);
+
+				if (end <= begin || end - begin < m_decommitMinBytes)
+					continue;
+
+				VirtualMemory::Decommit(reinterpret_cast<void *>(begin), end - begin);
+				region.decommitted = true;
+
+				// A region merged with a decommitted neighbour only hands back the pages it gained
+				uintptr_t base = reinterpret_cast<uintptr_t>(m_pageStorage.Data());
+				size_t firstPage = (begin - base) / m_osPageSize;
+				size_t lastPage = (end - base) / m_osPageSize;
+
+				if (m_decommittedPages.size() * BITMAP_WORD_BITS < lastPage)
+					m_decommittedPages.resize((lastPage + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS, 0);
+
+				for (size_t page = firstPage; page < lastPage; ++page)
+				{
+					uint64_t mask = 1ull << (page % BITMAP_WORD_BITS);
+					if ((m_decommittedPages[page / BITMAP_WORD_BITS] & mask) == 0)
+						decommittedBytes += m_osPageSize;
+
+					m_decommittedPages[page / BITMAP_WORD_BITS] |= mask;
+				}
+			}
+
+			m_decommittedBytes += decommittedBytes;
+			return decommittedBytes;
+		}
+
+		// Drops the contents of a thread cache left over from before the last Initialize or Reset
+		void SyncThreadCache(ThreadCache &cache) const
+		{
+			uint64_t generation = m_generation.load(std::memory_order_relaxed);
+
+			if (cache.generation != generation)
+			{
+				cache.counts.fill(0);
+				cache.generation = generation;
+			}
+		}
+
+		[[nodiscard]] size_t AllocCached(size_t count)
+		{
+			if (count > MAGAZINE_MAX_COUNT)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return AllocRegion(count);
+			}
+
+			size_t magazine = std::bit_width(count - 1);
+			size_t spanCount = static_cast<size_t>(1) << magazine;
+
+			ThreadCache &cache = GetThreadCache();
+			SyncThreadCache(cache);
+
+			if (cache.counts[magazine] == 0)
+			{
+				// Refill the magazine with a batch of spans
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				for (size_t i = 0; i < MAGAZINE_BATCH_COUNT; ++i)
+				{
+					size_t offset = AllocRegion(spanCount);
+					if (offset == NULL_INDEX)
+						break;
+
+					ClearBit(m_allocStarts, offset);
+					cache.offsets[magazine][cache.counts[magazine]++] = offset;
+				}
+
+				if (cache.counts[magazine] == 0)
+					return NULL_INDEX;
+			}
+
+			size_t offset = cache.offsets[magazine][--cache.counts[magazine]];
+
+			if (count != spanCount)
+			{
+				// The allocation ends where the caller asked, the rest of the span stays reserved as padding
+				ClearBit(m_allocEnds, offset + spanCount - 1);
+				SetBit(m_allocEnds, offset + count - 1);
+				SetBit(m_allocPadded, offset);
+			}
+
+			SetBit(m_allocStarts, offset);
+
+			return offset;
+		}
+
+		void FreeCached(size_t offset, size_t count)
+		{
+			if (count < MAGAZINE_MAX_COUNT && TestBit(m_allocPadded, offset))
+			{
+				// Restore the whole magazine span before caching it
+				ClearBit(m_allocPadded, offset);
+				ClearBit(m_allocEnds, offset + count - 1);
+				count = std::bit_ceil(count);
+				SetBit(m_allocEnds, offset + count - 1);
+			}
+
+			// Only spans handed out by a magazine go back to one
+			if (count > MAGAZINE_MAX_COUNT || !std::has_single_bit(count))
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				FreeRegion(offset, count);
+				return;
+			}
+
+			size_t magazine = std::bit_width(count - 1);
+
+			ThreadCache &cache = GetThreadCache();
+			SyncThreadCache(cache);
+
+			if (cache.counts[magazine] == MAGAZINE_CAPACITY)
+			{
+				// Drain the oldest spans of the magazine in one batch
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				auto &offsets = cache.offsets[magazine];
+
+				for (size_t i = 0; i < MAGAZINE_BATCH_COUNT; ++i)
+					FreeRegion(offsets[i], count);
+
+				std::copy(offsets.begin() + MAGAZINE_BATCH_COUNT, offsets.end(), offsets.begin());
+				cache.counts[magazine] -= MAGAZINE_BATCH_COUNT;
+			}
+
+			ClearBit(m_allocStarts, offset);
+			cache.offsets[magazine][cache.counts[magazine]++] = offset;
+		}
+
+		void FlushThreadCache(ThreadCache &cache)
+		{
+			if (!m_initialized || cache.generation != m_generation.load(std::memory_order_relaxed))
+				return;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (size_t magazine = 0; magazine < MAGAZINE_CLASS_COUNT; ++magazine)
+			{
+				for (size_t i = 0; i < cache.counts[magazine]; ++i)
+					FreeRegion(cache.offsets[magazine][i], static_cast<size_t>(1) << magazine);
+
+				cache.counts[magazine] = 0;
+			}
+		}
+
+		[[nodiscard]] size_t AcquireLink()
+		{
+			// Pop a previously released link if there is one
+			if (m_unusedLinksHead != NULL_INDEX)
+			{
+				size_t link = m_unusedLinksHead;
+				m_unusedLinksHead = m_freeRegionLinkStorage[link].binNext;
+				m_freeRegionLinkStorage[link].binNext = NULL_INDEX;
+				return link;
+			}
+
+			// Otherwise grow the link storage
+			m_freeRegionLinkStorage.emplace_back(0, 0);
+			return m_freeRegionLinkStorage.size() - 1;
+		}
+
+		void ReleaseLink(size_t link)
+		{
+			m_freeRegionLinkStorage[link] = AllocLink(0, 0); // Mark as unused
+			m_freeRegionLinkStorage[link].binNext = m_unusedLinksHead;
+			m_unusedLinksHead = link;
+		}
+
+		// Returns a free region of at least 'count' elements picked by the placement policy, or NULL_INDEX
+		[[nodiscard]] size_t FindSuitableRegion(size_t count) const
+		{
+			if constexpr (Policy == PlacementPolicy::BestFit)
+			{
+				// Regions in the class of 'count' itself may be too small, so scan it first
+				SizeClass sizeClass = MapSizeClass(count);
+				size_t best = NULL_INDEX;
+
+				if (sizeClass.first < SIZE_CLASS_COUNT)
+					best = FindTightestInBin(m_bins[sizeClass.first][sizeClass.second], count);
+
+				// Otherwise every region of the next non-empty class fits, take the smallest of them
+				if (best == NULL_INDEX)
+					best = FindTightestInBin(FindGoodFit(count), count);
+
+				return best;
+			}
+			else if constexpr (Policy == PlacementPolicy::FirstFit)
+			{
+				return TreeFindFirstFit(m_freeRegionsRoot, count, 0);
+			}
+			else if constexpr (Policy == PlacementPolicy::NextFit)
+			{
+				size_t found = TreeFindFirstFit(m_freeRegionsRoot, count, m_nextFitOffset);
+				return (found != NULL_INDEX) ? found : TreeFindFirstFit(m_freeRegionsRoot, count, 0);
+			}
+			else
+			{
+				return FindLowestInBin(FindGoodFit(count));
+			}
+		}
+
+		// Returns the lowest addressed region in the bin starting at 'link', or NULL_INDEX if it is empty
+		[[nodiscard]] size_t FindLowestInBin(size_t link) const
+		{
+			size_t lowest = link;
+
+			for (; link != NULL_INDEX; link = m_freeRegionLinkStorage[link].binNext)
+			{
+				if (m_freeRegionLinkStorage[link].offset < m_freeRegionLinkStorage[lowest].offset)
+					lowest = link;
+			}
+
+			return lowest;
+		}
+
+		// Returns the smallest region of at least 'count' elements in the bin starting at 'link', or NULL_INDEX
+		[[nodiscard]] size_t FindTightestInBin(size_t link, size_t count) const
+		{
+			size_t best = NULL_INDEX;
+
+			for (; link != NULL_INDEX; link = m_freeRegionLinkStorage[link].binNext)
+			{
+				size_t size = m_freeRegionLinkStorage[link].size;
+
+				if (size < count || (best != NULL_INDEX && size >= m_freeRegionLinkStorage[best].size))
+					continue;
+
+				best = link;
+				if (size == count)
+					break;
+			}
+
+			return best;
+		}
+
+		// Returns the head of the smallest size class guaranteed to fit 'count' elements in constant time, or NULL_INDEX
+		[[nodiscard]] size_t FindGoodFit(size_t count) const
+		{
+			SizeClass sizeClass = MapSizeClassRoundUp(count);
+
+			if (sizeClass.first >= SIZE_CLASS_COUNT)
+				return NULL_INDEX;
+
+			// Look for a non-empty bin in the same first-level class
+			uint32_t secondLevelMask = m_secondLevelMasks[sizeClass.first] & (~0u << sizeClass.second);
+
+			if (secondLevelMask == 0)
+			{
+				// Fall back to the next non-empty first-level class
+				uint64_t firstLevelMask = m_firstLevelMask & (~0ull << (sizeClass.first + 1));
+
+				if (firstLevelMask == 0)
+					return NULL_INDEX;
+
+				sizeClass.first = std::countr_zero(firstLevelMask);
+				secondLevelMask = m_secondLevelMasks[sizeClass.first];
+			}
+
+			sizeClass.second = std::countr_zero(secondLevelMask);
+
+			return m_bins[sizeClass.first][sizeClass.second];
+		}
+
+		void InsertIntoBin(size_t link)
+		{
+			AllocLink &region = m_freeRegionLinkStorage[link];
+			SizeClass sizeClass = MapSizeClass(region.size);
+			size_t &head = m_bins[sizeClass.first][sizeClass.second];
+
+			region.binPrev = NULL_INDEX;
+			region.binNext = head;
+
+			if (head != NULL_INDEX)
+				m_freeRegionLinkStorage[head].binPrev = link;
+
+			head = link;
+
+			m_firstLevelMask |= (1ull << sizeClass.first);
+			m_secondLevelMasks[sizeClass.first] |= (1u << sizeClass.second);
+
+			// Every size change ends with the region being re-binned, refresh the subtree maximums above it
+			if constexpr (ADDRESS_ORDERED_FIT)
+				TreeRefresh(m_freeRegionsRoot, region.offset);
+		}
+
+		void RemoveFromBin(size_t link)
+		{
+			AllocLink &region = m_freeRegionLinkStorage[link];
+			SizeClass sizeClass = MapSizeClass(region.size);
+
+			if (region.binNext != NULL_INDEX)
+				m_freeRegionLinkStorage[region.binNext].binPrev = region.binPrev;
+
+			if (region.binPrev != NULL_INDEX)
+			{
+				m_freeRegionLinkStorage[region.binPrev].binNext = region.binNext;
+			}
+			else
+			{
+				m_bins[sizeClass.first][sizeClass.second] = region.binNext;
+
+				// Clear the bin bits once it runs empty
+				if (region.binNext == NULL_INDEX)
+				{
+					m_secondLevelMasks[sizeClass.first] &= ~(1u << sizeClass.second);
+
+					if (m_secondLevelMasks[sizeClass.first] == 0)
+						m_firstLevelMask &= ~(1ull << sizeClass.first);
+				}
+			}
+
+			region.binNext = NULL_INDEX;
+			region.binPrev = NULL_INDEX;
+		}
+
+		// Finds the closest free regions below and above 'offset' in O(log n)
+		void FindNeighbours(size_t offset, size_t &left, size_t &right) const
+		{
+			size_t node = m_freeRegionsRoot;
+
+			while (node != NULL_INDEX)
+			{
+				if (offset < m_freeRegionLinkStorage[node].offset)
+				{
+					right = node;
+					node = m_freeRegionLinkStorage[node].left;
+				}
+				else
+				{
+					left = node;
+					node = m_freeRegionLinkStorage[node].right;
+				}
+			}
+		}
+
+		[[nodiscard]] size_t TreeHeight(size_t node) const
+		{
+			return (node == NULL_INDEX) ? 0 : m_freeRegionLinkStorage[node].height;
+		}
+
+		void TreeUpdate(size_t node)
+		{
+			AllocLink &region = m_freeRegionLinkStorage[node];
+			region.height = 1 + std::max(TreeHeight(region.left), TreeHeight(region.right));
+
+			if constexpr (ADDRESS_ORDERED_FIT)
+				region.maxSize = std::max({ region.size, TreeMaxSize(region.left), TreeMaxSize(region.right) });
+		}
+
+		[[nodiscard]] size_t TreeMaxSize(size_t node) const
+		{
+			return (node == NULL_INDEX) ? 0 : m_freeRegionLinkStorage[node].maxSize;
+		}
+
+		// Updates the nodes on the path to the region at 'offset' after its size changed
+		void TreeRefresh(size_t node, size_t offset)
+		{
+			if (node == NULL_INDEX)
+				return;
+
+			AllocLink &region = m_freeRegionLinkStorage[node];
+
+			if (offset < region.offset)
+				TreeRefresh(region.left, offset);
+			else if (offset > region.offset)
+				TreeRefresh(region.right, offset);
+
+			TreeUpdate(node);
+		}
+
+		// Returns the lowest addressed region at or after 'minOffset' with at least 'count' elements, or NULL_INDEX
+		[[nodiscard]] size_t TreeFindFirstFit(size_t node, size_t count, size_t minOffset) const
+		{
+			if (node == NULL_INDEX || m_freeRegionLinkStorage[node].maxSize < count)
+				return NULL_INDEX;
+
+			const AllocLink &region = m_freeRegionLinkStorage[node];
+
+			if (region.offset >= minOffset)
+			{
+				size_t found = TreeFindFirstFit(region.left, count, minOffset);
+				if (found != NULL_INDEX)
+					return found;
+
+				if (region.size >= count)
+					return node;
+			}
+
+			return TreeFindFirstFit(region.right, count, minOffset);
+		}
+
+		[[nodiscard]] size_t TreeRotateLeft(size_t node)
+		{
+			size_t pivot = m_freeRegionLinkStorage[node].right;
+			m_freeRegionLinkStorage[node].right = m_freeRegionLinkStorage[pivot].left;
+			m_freeRegionLinkStorage[pivot].left = node;
+
+			TreeUpdate(node);
+			TreeUpdate(pivot);
+			return pivot;
+		}
+
+		[[nodiscard]] size_t TreeRotateRight(size_t node)
+		{
+			size_t pivot = m_freeRegionLinkStorage[node].left;
+			m_freeRegionLinkStorage[node].left = m_freeRegionLinkStorage[pivot].right;
+			m_freeRegionLinkStorage[pivot].right = node;
+
+			TreeUpdate(node);
+			TreeUpdate(pivot);
+			return pivot;
+		}
+
+		// Restores the AVL balance of 'node', returns the new subtree root
+		[[nodiscard]] size_t TreeRebalance(size_t node)
+		{
+			TreeUpdate(node);
+
+			AllocLink &region = m_freeRegionLinkStorage[node];
+			size_t leftHeight = TreeHeight(region.left);
+			size_t rightHeight = TreeHeight(region.right);
+
+			if (leftHeight > rightHeight + 1)
+			{
+				const AllocLink &child = m_freeRegionLinkStorage[region.left];
+				if (TreeHeight(child.left) < TreeHeight(child.right))
+					region.left = TreeRotateLeft(region.left);
+
+				return TreeRotateRight(node);
+			}
+
+			if (rightHeight > leftHeight + 1)
+			{
+				const AllocLink &child = m_freeRegionLinkStorage[region.right];
+				if (TreeHeight(child.right) < TreeHeight(child.left))
+					region.right = TreeRotateRight(region.right);
+
+				return TreeRotateLeft(node);
+			}
+
+			return node;
+		}
+
+		// Inserts 'link' into the subtree at 'node', returns the new subtree root
+		[[nodiscard]] size_t TreeInsert(size_t node, size_t link)
+		{
+			if (node == NULL_INDEX)
+				return link;
+
+			AllocLink &region = m_freeRegionLinkStorage[node];
+
+			if (m_freeRegionLinkStorage[link].offset < region.offset)
+				region.left = TreeInsert(region.left, link);
+			else
+				region.right = TreeInsert(region.right, link);
+
+			return TreeRebalance(node);
+		}
+
+		// Detaches the lowest region of the subtree at 'node', returns the new subtree root
+		[[nodiscard]] size_t TreeEraseMin(size_t node)
+		{
+			AllocLink &region = m_freeRegionLinkStorage[node];
+
+			if (region.left == NULL_INDEX)
+				return region.right;
+
+			region.left = TreeEraseMin(region.left);
+			return TreeRebalance(node);
+		}
+
+		// Removes the region starting at 'offset' from the subtree at 'node', returns the new subtree root
+		[[nodiscard]] size_t TreeErase(size_t node, size_t offset)
+		{
+			if (node == NULL_INDEX)
+				return NULL_INDEX;
+
+			AllocLink &region = m_freeRegionLinkStorage[node];
+
+			if (offset < region.offset)
+			{
+				region.left = TreeErase(region.left, offset);
+			}
+			else if (offset > region.offset)
+			{
+				region.right = TreeErase(region.right, offset);
+			}
+			else
+			{
+				if (region.right == NULL_INDEX)
+					return region.left;
+
+				// Replace the erased region with its successor
+				size_t successor = region.right;
+				while (m_freeRegionLinkStorage[successor].left != NULL_INDEX)
+					successor = m_freeRegionLinkStorage[successor].left;
+
+				m_freeRegionLinkStorage[successor].right = TreeEraseMin(region.right);
+				m_freeRegionLinkStorage[successor].left = region.left;
+
+				return TreeRebalance(successor);
+			}
+
+			return TreeRebalance(node);
+		}
+
+		void CollectInOrder(size_t node, std::vector<AllocLink> &regions) const
+		{
+			if (node == NULL_INDEX)
+				return;
+
+			CollectInOrder(m_freeRegionLinkStorage[node].left, regions);
+			regions.push_back(m_freeRegionLinkStorage[node]);
+			CollectInOrder(m_freeRegionLinkStorage[node].right, regions);
+		}
+	};
+
+	// Refers to a relocatable allocation, see PageRegistry::AllocHandle
+	template <typename T, PlacementPolicy Policy>
+	class Handle
+	{
+	public:
+		Handle() = default;
+
+		// The returned pointer is only valid until the next call to Compact
+		[[nodiscard]] T *Get() const
+		{
+			return PageRegistry<T, Policy>::Resolve(*this);
+		}
+
+		[[nodiscard]] bool IsNull() const
+		{
+			return m_index == NULL_INDEX;
+		}
+
+	private:
+		friend class PageRegistry<T, Policy>;
+
+		Handle(size_t index, size_t generation)
+			: m_index(index), m_generation(generation) { }
+
+		size_t m_index = NULL_INDEX;
+		size_t m_generation = 0;
+	};
+
+	// Constructs each of the 'count' elements of a fresh allocation from 'args', freeing it if a constructor throws.
+	// Construction is skipped for trivially default constructible types when no arguments are given.
+	template <typename T, typename... Args>
+	inline T *ConstructAllocated(T *ptr, size_t count, const Args &...args)
+	{
+		if (ptr == nullptr)
+			return nullptr;
+
+		if constexpr (sizeof...(Args) > 0 || !std::is_trivially_default_constructible_v<T>)
+		{
+			size_t constructed = 0;
+
+			try
+			{
+				for (; constructed < count; ++constructed)
+					::new (static_cast<void *>(ptr + constructed)) T(args...);
+			}
+			catch (...)
+			{
+				std::destroy_n(ptr, constructed);
+				PageRegistry<T>::Free(ptr);
+				throw;
+			}
+		}
+
+		PageRegistry<T>::MarkConstructed(ptr);
+		return ptr;
+	}
+
+	// Allocates 'count' elements and constructs each of them from 'args'
+	template <typename T, typename... Args>
+	[[nodiscard]] inline T *New(size_t count, const Args &...args)
+	{
+		return ConstructAllocated(PageRegistry<T>::Alloc(count), count, args...);
+	}
+
+	// Allocates 'count' elements at an address that is a multiple of 'alignment' and constructs each of them from 'args'
+	template <typename T, typename... Args>
+	[[nodiscard]] inline T *AllocAligned(size_t count, size_t alignment, const Args &...args)
+	{
+		return ConstructAllocated(PageRegistry<T>::AllocAligned(count, alignment), count, args...);
+	}
+
+	// Destroys every element of an allocation made by New() or Alloc() and frees it
+	template <typename T>
+	inline int Delete(T *ptr)
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			size_t count = PageRegistry<T>::GetAllocatedCount(ptr);
+
+			if (count > 0)
+				std::destroy_n(ptr, count);
+		}
+
+		return PageRegistry<T>::Free(ptr);
+	}
+
+	// Resizes an allocation made by New() or Alloc(), keeping its first elements.
+	// Grows or shrinks in place when possible and moves the elements to a new allocation otherwise.
+	// Added elements are value-initialized. Returns the possibly moved allocation, or nullptr if it could
+	// not be grown, in which case the original allocation is left untouched.
+	template <typename T>
+	[[nodiscard]] inline T *Realloc(T *ptr, size_t newCount)
+	{
+		if (ptr == nullptr)
+		{
+			T *newPtr = PageRegistry<T>::Alloc(newCount);
+			if (newPtr == nullptr)
+				return nullptr;
+
+			try
+			{
+				std::uninitialized_value_construct_n(newPtr, newCount);
+			}
+			catch (...)
+			{
+				PageRegistry<T>::Free(newPtr);
+				throw;
+			}
+
+			PageRegistry<T>::MarkConstructed(newPtr);
+			return newPtr;
+		}
+
+		size_t count = PageRegistry<T>::GetAllocatedCount(ptr);
+		if (count == 0 || newCount == 0)
+			return nullptr;
+
+		if (newCount <= count)
+		{
+			std::destroy_n(ptr + newCount, count - newCount);
+			PageRegistry<T>::Resize(ptr, newCount);
+			return ptr;
+		}
+
+		// Trivial types are value-initialized too, the grown tail may hold stale elements of a previous allocation
+		if (PageRegistry<T>::Resize(ptr, newCount) == 0)
+		{
+			try
+			{
+				std::uninitialized_value_construct_n(ptr + count, newCount - count);
+			}
+			catch (...)
+			{
+				PageRegistry<T>::Resize(ptr, count);
+				throw;
+			}
+
+			return ptr;
+		}
+
+		// Last resort, move everything to a new allocation
+		T *newPtr = PageRegistry<T>::Alloc(newCount);
+		if (newPtr == nullptr)
+			return nullptr;
+
+		try
+		{
+			std::uninitialized_value_construct_n(newPtr + count, newCount - count);
+		}
+		catch (...)
+		{
+			PageRegistry<T>::Free(newPtr);
+			throw;
+		}
+
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			std::memcpy(static_cast<void *>(newPtr), static_cast<const void *>(ptr), count * sizeof(T));
+		}
+		else
+		{
+			std::uninitialized_move_n(ptr, count, newPtr);
+			std::destroy_n(ptr, count);
+		}
+
+		PageRegistry<T>::MarkConstructed(newPtr);
+		PageRegistry<T>::Free(ptr);
+		return newPtr;
+	}
+
+	// Allocates up to 'n' spans of 'count' default constructed elements into 'out', returns the number allocated
+	template <typename T>
+	inline size_t AllocBatch(size_t count, size_t n, T **out)
+	{
+		size_t allocated = PageRegistry<T>::AllocBatch(count, n, out);
+
+		if constexpr (!std::is_trivially_default_constructible_v<T>)
+		{
+			size_t constructed = 0;
+
+			try
+			{
+				for (; constructed < allocated; ++constructed)
+					std::uninitialized_value_construct_n(out[constructed], count);
+			}
+			catch (...)
+			{
+				for (size_t i = 0; i < constructed; ++i)
+					std::destroy_n(out[i], count);
+
+				PageRegistry<T>::FreeBatch(out, allocated);
+				std::fill_n(out, allocated, nullptr);
+				throw;
+			}
+		}
+
+		for (size_t i = 0; i < allocated; ++i)
+			PageRegistry<T>::MarkConstructed(out[i]);
+
+		return allocated;
+	}
+
+	// Destroys and frees every allocation in 'ptrs', returns the number freed.
+	// Unlike PageRegistry::FreeBatch, each allocation may only appear once.
+	template <typename T>
+	inline size_t FreeBatch(T *const *ptrs, size_t n)
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				size_t count = PageRegistry<T>::GetAllocatedCount(ptrs[i]);
+
+				if (count > 0)
+					std::destroy_n(ptrs[i], count);
+			}
+		}
+
+		return PageRegistry<T>::FreeBatch(ptrs, n);
+	}
+
+	template <typename T>
+	[[nodiscard]] inline T *Alloc(size_t count)
+	{
+		return New<T>(count);
+	}
+
+	template <typename T>
+	inline int Free(T *ptr)
+	{
+		return Delete<T>(ptr);
 	}
 }
\ No newline at end of file
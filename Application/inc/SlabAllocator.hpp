@@ -0,0 +1,300 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <memory>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "BuddyAllocator.hpp"
+
+// Small object allocator on top of a buddy allocator.
+// Requests of up to MAX_SMALL_SIZE bytes are rounded up to one of 64 size classes and served from slabs, buddy blocks
+// carved into equally sized slots with a free bitmap kept outside the block. Larger requests go straight to the buddy.
+// Classes are 16 bytes apart up to 128 bytes and eight per power of two above that, so rounding wastes at most 1/9.
+template <typename Buddy = BuddyAllocator, size_t SlabSize = 64 * 1024>
+class SlabAllocator
+{
+public:
+	static constexpr size_t MAX_SMALL_SIZE = 16 * 1024;
+	static constexpr size_t NUM_CLASSES = 64;
+
+private:
+	static constexpr size_t MIN_CLASS_SIZE = 16;
+	static constexpr size_t MAX_SLOTS = SlabSize / MIN_CLASS_SIZE;
+	static constexpr size_t BITMAP_WORDS = (MAX_SLOTS + 63) / 64;
+
+	static_assert(std::has_single_bit(SlabSize), "Slab size must be a power of two");
+	static_assert(SlabSize >= Buddy::GetMinimumBlockSize() && SlabSize >= 4 * MAX_SMALL_SIZE, "Slabs must be buddy blocks holding several objects");
+	static_assert(Buddy::GetArenaSize() >= SlabSize, "The arena must hold at least one slab");
+
+	struct Slab
+	{
+		char* memory = nullptr;
+		Slab* prev = nullptr;
+		Slab* next = nullptr;
+
+		uint32_t classIndex = 0;
+		uint32_t freeCount = 0;
+		uint32_t firstFreeWord = 0; // No free slots before this bitmap word
+
+		std::array<uint64_t, BITMAP_WORDS> freeSlots; // Set bits are free slots
+	};
+
+	Buddy& m_buddy;
+
+	std::array<Slab*, NUM_CLASSES> m_partialSlabs = {}; // Per class, slabs with at least one free slot
+	std::array<size_t, NUM_CLASSES> m_slabBytes = {}; // Per class, size of the buddy block backing a slab
+
+	std::vector<Slab*> m_slabTable; // Per SlabSize unit of the arena, the slab covering it
+	std::vector<std::unique_ptr<Slab>> m_slabStorage;
+	std::vector<Slab*> m_spareSlabs; // Headers in m_slabStorage that are not backing a slab
+
+	size_t m_slabCount = 0;
+	size_t m_slabBytesInUse = 0;
+
+	size_t SlotCount(size_t classIndex) const
+	{
+		return m_slabBytes[classIndex] / ClassSize(classIndex);
+	}
+
+	void PushPartial(Slab* slab)
+	{
+		Slab*& head = m_partialSlabs[slab->classIndex];
+
+		slab->prev = nullptr;
+		slab->next = head;
+
+		if (head != nullptr)
+			head->prev = slab;
+
+		head = slab;
+	}
+
+	void RemovePartial(Slab* slab)
+	{
+		if (slab->prev != nullptr)
+			slab->prev->next = slab->next;
+		else
+			m_partialSlabs[slab->classIndex] = slab->next;
+
+		if (slab->next != nullptr)
+			slab->next->prev = slab->prev;
+
+		slab->prev = nullptr;
+		slab->next = nullptr;
+	}
+
+	void SetTableEntries(Slab* slab, Slab* value)
+	{
+		size_t first = (slab->memory - m_buddy.GetBase()) / SlabSize;
+		size_t count = m_slabBytes[slab->classIndex] / SlabSize;
+
+		for (size_t i = 0; i < count; i++)
+			m_slabTable[first + i] = value;
+	}
+
+	// Takes a block from the buddy and makes it a slab of the given class, nullptr if the buddy is out of memory
+	Slab* CreateSlab(size_t classIndex)
+	{
+		char* memory = (char*)m_buddy.Alloc(m_slabBytes[classIndex]);
+		if (memory == nullptr)
+			return nullptr;
+
+		Slab* slab;
+		if (!m_spareSlabs.empty())
+		{
+			slab = m_spareSlabs.back();
+			m_spareSlabs.pop_back();
+		}
+		else
+		{
+			m_slabStorage.push_back(std::make_unique<Slab>());
+			slab = m_slabStorage.back().get();
+		}
+
+		size_t slotCount = SlotCount(classIndex);
+
+		slab->memory = memory;
+		slab->classIndex = (uint32_t)classIndex;
+		slab->freeCount = (uint32_t)slotCount;
+		slab->firstFreeWord = 0;
+
+		for (size_t word = 0; word < BITMAP_WORDS; word++)
+		{
+			size_t firstSlot = word * 64;
+
+			if (firstSlot + 64 <= slotCount)
+				slab->freeSlots[word] = ~0ULL;
+			else if (firstSlot < slotCount)
+				slab->freeSlots[word] = (1ULL << (slotCount - firstSlot)) - 1;
+			else
+				slab->freeSlots[word] = 0;
+		}
+
+		SetTableEntries(slab, slab);
+		PushPartial(slab);
+
+		m_slabCount++;
+		m_slabBytesInUse += m_slabBytes[classIndex];
+
+		return slab;
+	}
+
+	void ReleaseSlab(Slab* slab)
+	{
+		RemovePartial(slab);
+		SetTableEntries(slab, nullptr);
+
+		m_buddy.Free(slab->memory);
+
+		m_slabCount--;
+		m_slabBytesInUse -= m_slabBytes[slab->classIndex];
+
+		slab->memory = nullptr;
+		m_spareSlabs.push_back(slab);
+	}
+
+public:
+	explicit SlabAllocator(Buddy& buddy)
+		: m_buddy(buddy)
+	{
+		m_slabTable.resize(Buddy::GetArenaSize() / SlabSize, nullptr);
+
+		// Classes whose objects don't divide the slab evenly get larger slabs, until the unused tail is at most 1/64
+		for (size_t i = 0; i < NUM_CLASSES; i++)
+		{
+			size_t slabBytes = SlabSize;
+			while (slabBytes % ClassSize(i) > slabBytes / 64)
+				slabBytes *= 2;
+
+			m_slabBytes[i] = slabBytes;
+		}
+	}
+
+	// Hands every slab back to the buddy, large allocations stay with it
+	~SlabAllocator()
+	{
+		for (const std::unique_ptr<Slab>& slab : m_slabStorage)
+		{
+			if (slab->memory != nullptr)
+				m_buddy.Free(slab->memory);
+		}
+	}
+
+	SlabAllocator(const SlabAllocator&) = delete;
+	SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+	static constexpr size_t ClassSize(size_t classIndex)
+	{
+		if (classIndex < 8)
+			return (classIndex + 1) * MIN_CLASS_SIZE;
+
+		size_t power = 7 + (classIndex - 8) / 8;
+		size_t step = (classIndex - 8) % 8 + 1;
+
+		return ((size_t)1 << power) + step * ((size_t)1 << (power - 3));
+	}
+
+	// Class of the smallest slot holding 'size' bytes, 'size' must be between 1 and MAX_SMALL_SIZE
+	static constexpr size_t ClassIndex(size_t size)
+	{
+		if (size <= 128)
+			return (size + MIN_CLASS_SIZE - 1) / MIN_CLASS_SIZE - 1;
+
+		size_t power = std::bit_width(size - 1) - 1;
+		size_t stepSize = (size_t)1 << (power - 3);
+		size_t step = (size - ((size_t)1 << power) + stepSize - 1) / stepSize;
+
+		return 8 + (power - 7) * 8 + step - 1;
+	}
+
+	void* Alloc(size_t size)
+	{
+		if (size == 0)
+			return nullptr;
+
+		if (size > MAX_SMALL_SIZE)
+			return m_buddy.Alloc(size);
+
+		size_t classIndex = ClassIndex(size);
+
+		Slab* slab = m_partialSlabs[classIndex];
+		if (slab == nullptr)
+		{
+			slab = CreateSlab(classIndex);
+			if (slab == nullptr)
+				return nullptr;
+		}
+
+		size_t word = slab->firstFreeWord;
+		while (slab->freeSlots[word] == 0)
+			word++;
+
+		size_t bit = std::countr_zero(slab->freeSlots[word]);
+		slab->freeSlots[word] &= slab->freeSlots[word] - 1;
+		slab->firstFreeWord = (uint32_t)word;
+
+		if (--slab->freeCount == 0)
+			RemovePartial(slab);
+
+		return slab->memory + (word * 64 + bit) * ClassSize(classIndex);
+	}
+
+	void Free(void* mem)
+	{
+		if (mem == nullptr)
+			return;
+
+		ptrdiff_t signedOffset = (char*)mem - m_buddy.GetBase();
+		Slab* slab = nullptr;
+
+		if (m_buddy.GetBase() != nullptr && signedOffset >= 0 && (size_t)signedOffset < Buddy::GetArenaSize())
+			slab = m_slabTable[(size_t)signedOffset / SlabSize];
+
+		if (slab == nullptr)
+		{
+			m_buddy.Free(mem);
+			return;
+		}
+
+		size_t classSize = ClassSize(slab->classIndex);
+		size_t slotOffset = (char*)mem - slab->memory;
+
+		if (slotOffset % classSize != 0)
+			return; // Not the start of a slot
+
+		size_t slot = slotOffset / classSize;
+		if (slot >= SlotCount(slab->classIndex))
+			return; // In the unused tail of the slab
+
+		size_t word = slot / 64;
+		uint64_t mask = 1ULL << (slot % 64);
+
+		if (slab->freeSlots[word] & mask)
+			return; // Already free
+
+		slab->freeSlots[word] |= mask;
+		if (word < slab->firstFreeWord)
+			slab->firstFreeWord = (uint32_t)word;
+
+		if (slab->freeCount++ == 0)
+			PushPartial(slab);
+
+		// Empty slabs go back to the buddy, except the last one of the class so a lone object doesn't keep remapping it
+		bool isOnlySlab = slab->prev == nullptr && slab->next == nullptr;
+		if (slab->freeCount == SlotCount(slab->classIndex) && !isOnlySlab)
+			ReleaseSlab(slab);
+	}
+
+	size_t GetSlabCount() const
+	{
+		return m_slabCount;
+	}
+
+	// Bytes taken from the buddy for slabs
+	size_t GetSlabBytes() const
+	{
+		return m_slabBytesInUse;
+	}
+};
@@ -2,20 +2,51 @@
 #include <memory>
 #include <array>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
 
 constexpr size_t STACK_SIZE = 1 << 14;
-typedef std::unique_ptr<std::array<char, STACK_SIZE>> StorageType;
+constexpr size_t STACK_ALIGNMENT = 64; // Cache line, so offsets and addresses are equally aligned for any smaller alignment
+
+struct alignas(STACK_ALIGNMENT) AlignedStackStorage : std::array<char, STACK_SIZE> {};
+typedef std::unique_ptr<AlignedStackStorage> StorageType;
 
 class StackAllocator
 {
 private:
 	StorageType m_stack;
 	size_t m_top = 0;
+	size_t m_peakTop = 0;
+	size_t m_paddingBytes = 0;
+
+	// Moves the top past 'size' bytes aligned to 'align', a power of two.
+	// Returns the offset of the first one, or (size_t)-1 if they don't fit.
+	size_t Reserve(size_t size, size_t align)
+	{
+		size_t padding = (0 - (uintptr_t)(m_stack.get()->data() + m_top)) & (align - 1);
+
+		if (padding > STACK_SIZE - m_top || size > STACK_SIZE - m_top - padding)
+			return (size_t)-1;
+
+		size_t start = m_top + padding;
+
+		m_top = start + size;
+		m_paddingBytes += padding;
+
+		if (m_top > m_peakTop)
+			m_peakTop = m_top;
+
+		return start;
+	}
 
 public:
 	StackAllocator()
 	{
-		m_stack = std::make_unique<std::array<char, STACK_SIZE>>();
+		m_stack = std::make_unique<AlignedStackStorage>();
 		*(m_stack.get()) = {};
 	}
 
@@ -27,26 +58,69 @@ public:
 		return &m_stack.get()->at(idx);
 	}
 
-	size_t Push(void* data, size_t size)
+	// Copies 'size' bytes on top of the stack, aligned to 'align', a power of two. Raw bytes are packed by default.
+	// Returns their offset, or (size_t)-1 if they don't fit.
+	size_t Push(const void* data, size_t size, size_t align = 1)
 	{
-		if (m_top + size > STACK_SIZE)
+		size_t start = Reserve(size, align);
+		if (start == (size_t)-1)
 			return (size_t)-1;
 
-		size_t start = m_top;
-		char* begin = m_stack.get()->data();
-
-		for (size_t i = 0; i < size; i++)
-		{
-			begin[m_top] = ((char*)data)[i];
-			m_top++;
-		}
+		memcpy(m_stack.get()->data() + start, data, size);
 
 		return start;
 	}
 
+	// Copies 'value' on top of the stack, aligned for T
+	template <typename T>
+	size_t Push(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Push copies bytes, use Emplace for other types");
+
+		return Push(&value, sizeof(T), alignof(T));
+	}
+
+	// Reserves uninitialized space on top of the stack, 'align' must be a power of two.
+	// Returns nullptr if it doesn't fit.
+	void* Allocate(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		size_t start = Reserve(size, align);
+		if (start == (size_t)-1)
+			return nullptr;
+
+		return m_stack.get()->data() + start;
+	}
+
+	// Constructs a T on top of the stack, nullptr if it doesn't fit.
+	// The stack never runs destructors, so T should be trivially destructible or destroyed by the caller.
+	template <typename T, typename... Args>
+	T* Emplace(Args&&... args)
+	{
+		void* mem = Allocate(sizeof(T), alignof(T));
+		if (mem == nullptr)
+			return nullptr;
+
+		return new (mem) T(std::forward<Args>(args)...);
+	}
+
+	// Position of the top, everything pushed after it can be released with FreeToMarker
+	size_t GetMarker()
+	{
+		return m_top;
+	}
+
+	// Releases everything pushed since 'marker' was taken, markers above the top are ignored
+	void FreeToMarker(size_t marker)
+	{
+		if (marker <= m_top)
+			m_top = marker;
+	}
+
 	void Reset()
 	{
 		m_top = 0;
+		m_peakTop = 0;
+		m_paddingBytes = 0;
 	}
 
 	size_t DBG_GetTop()
@@ -54,6 +128,18 @@ public:
 		return m_top;
 	}
 
+	// Highest the top has been since the last Reset
+	size_t DBG_GetPeakTop()
+	{
+		return m_peakTop;
+	}
+
+	// Bytes skipped to align pushes since the last Reset
+	size_t DBG_GetPaddingBytes()
+	{
+		return m_paddingBytes;
+	}
+
 	StorageType& DBG_GetStack()
 	{
 		return m_stack;
@@ -63,4 +149,26 @@ public:
 	{
 		return STACK_SIZE;
 	}
-};
\ No newline at end of file
+};
+
+// Releases everything pushed onto a StackAllocator during its lifetime
+class ScopedStack
+{
+private:
+	StackAllocator& m_allocator;
+	size_t m_marker;
+
+public:
+	explicit ScopedStack(StackAllocator& allocator)
+		: m_allocator(allocator), m_marker(allocator.GetMarker())
+	{
+	}
+
+	~ScopedStack()
+	{
+		m_allocator.FreeToMarker(m_marker);
+	}
+
+	ScopedStack(const ScopedStack&) = delete;
+	ScopedStack& operator=(const ScopedStack&) = delete;
+};
@@ -0,0 +1,185 @@
+// VirtualMemory.hpp reserves address space up front and commits memory into it on demand.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <cstdio>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace MemoryInternal
+{
+	namespace VirtualMemory
+	{
+		[[nodiscard]] inline size_t GetPageSize()
+		{
+#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return static_cast<size_t>(info.dwPageSize);
+#else
+			return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		}
+
+		[[nodiscard]] inline size_t RoundUpToPage(size_t bytes)
+		{
+			size_t pageSize = GetPageSize();
+			return (bytes + pageSize - 1) & ~(pageSize - 1);
+		}
+
+		// Reserves address space without backing it, returns nullptr on failure
+		[[nodiscard]] inline void *Reserve(size_t bytes)
+		{
+#ifdef _WIN32
+			return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+			void *address = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			return (address == MAP_FAILED) ? nullptr : address;
+#endif
+		}
+
+		// Makes a page-aligned range of reserved address space usable
+		inline bool Commit(void *address, size_t bytes)
+		{
+#ifdef _WIN32
+			return VirtualAlloc(address, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+			return mprotect(address, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+		}
+
+		// Hands the physical memory behind a page-aligned committed range back to the OS.
+		// The range stays reserved and usable, its contents are lost.
+		inline void Decommit(void *address, size_t bytes)
+		{
+#ifdef _WIN32
+			VirtualAlloc(address, bytes, MEM_RESET, PAGE_READWRITE);
+#else
+			madvise(address, bytes, MADV_DONTNEED);
+#endif
+		}
+
+		// Releases a whole reservation made by Reserve
+		inline void Release(void *address, size_t bytes)
+		{
+#ifdef _WIN32
+			(void)bytes;
+			VirtualFree(address, 0, MEM_RELEASE);
+#else
+			munmap(address, bytes);
+#endif
+		}
+
+		// Returns the resident set size of the process in bytes, or 0 if it is unavailable
+		[[nodiscard]] inline size_t GetResidentBytes()
+		{
+#ifdef _WIN32
+			PROCESS_MEMORY_COUNTERS counters;
+			if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+				return 0;
+
+			return static_cast<size_t>(counters.WorkingSetSize);
+#else
+			FILE *file = fopen("/proc/self/statm", "r");
+			if (file == nullptr)
+				return 0;
+
+			unsigned long long totalPages = 0;
+			unsigned long long residentPages = 0;
+			int read = fscanf(file, "%llu %llu", &totalPages, &residentPages);
+			fclose(file);
+
+			return (read == 2) ? static_cast<size_t>(residentPages) * GetPageSize() : 0;
+#endif
+		}
+	}
+
+	// Array of up to a fixed number of elements whose address never changes.
+	// Address space for all of them is reserved up front, memory is committed as the array grows.
+	// Elements are not constructed, committed memory reads as zero.
+	template <typename E>
+	class VirtualArray
+	{
+	public:
+		VirtualArray() = default;
+		~VirtualArray()
+		{
+			Release();
+		}
+
+		VirtualArray(const VirtualArray &) = delete;
+		VirtualArray &operator=(const VirtualArray &) = delete;
+
+		bool Reserve(size_t maxCount)
+		{
+			Release();
+
+			size_t bytes = VirtualMemory::RoundUpToPage(maxCount * sizeof(E));
+			m_data = static_cast<E *>(VirtualMemory::Reserve(bytes));
+
+			if (m_data == nullptr)
+				return false;
+
+			m_reservedBytes = bytes;
+			m_reservedCount = maxCount;
+			return true;
+		}
+
+		// Makes sure the first 'count' elements are backed by memory
+		bool Commit(size_t count)
+		{
+			if (count > m_reservedCount)
+				return false;
+
+			size_t bytes = VirtualMemory::RoundUpToPage(count * sizeof(E));
+			if (bytes <= m_committedBytes)
+				return true;
+
+			if (!VirtualMemory::Commit(reinterpret_cast<char *>(m_data) + m_committedBytes, bytes - m_committedBytes))
+				return false;
+
+			m_committedBytes = bytes;
+			return true;
+		}
+
+		void Release()
+		{
+			if (m_data == nullptr)
+				return;
+
+			VirtualMemory::Release(m_data, m_reservedBytes);
+
+			m_data = nullptr;
+			m_reservedBytes = 0;
+			m_reservedCount = 0;
+			m_committedBytes = 0;
+		}
+
+		[[nodiscard]] E *Data() const { return m_data; }
+		[[nodiscard]] size_t ReservedCount() const { return m_reservedCount; }
+		[[nodiscard]] size_t CommittedBytes() const { return m_committedBytes; }
+
+		E &operator[](size_t index) { return m_data[index]; }
+		const E &operator[](size_t index) const { return m_data[index]; }
+
+	private:
+		E *m_data = nullptr;
+		size_t m_reservedBytes = 0;
+		size_t m_reservedCount = 0;
+		size_t m_committedBytes = 0;
+	};
+}
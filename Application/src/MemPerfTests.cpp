@@ -1,16 +1,159 @@
 #include "MemPerfTests.hpp"
 #include "PageRegistry.hpp"
+#include "BuddyAllocator.hpp"
+#include "BuddyHeap.hpp"
+#include "StackAllocator.hpp"
+#include "DoubleEndedStackAllocator.hpp"
+#include "DoubleBufferedAllocator.hpp"
+#include "ChainedStackAllocator.hpp"
+#include "SlabAllocator.hpp"
 
 #include "TracyClient/public/tracy/Tracy.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <random>
+#include <vector>
 
 
 constexpr int allocCount = 1000;
 constexpr int maxConcurrentAllocs = 32;
 constexpr int maxAllocSize = 1 << 11;
 constexpr size_t pageSize = 1ull << 16;
+constexpr int maxThreadedAllocSize = 1 << 7; // Small enough to be served by the per-thread caches
+
+
+// The recursive, pointer-linked BuddyAllocator this repository used before, kept as a baseline for RunBuddyTests
+class LegacyBuddyAllocator
+{
+private:
+	struct Block
+	{
+		bool isFree = true;
+		size_t size = 0;
+		size_t offset = 0;
+
+		Block* left = nullptr;
+		Block* right = nullptr;
+		Block* parent = nullptr;
+	};
+
+	std::unique_ptr<std::array<char, 4096 * 1024>> m_memory;
+	size_t m_minimumSize = 32 * 1024;
+
+	size_t m_numRows = (size_t)(log2(4096 * 1024) - log2(m_minimumSize));
+	size_t m_numBlocks = (size_t)pow(2, m_numRows + 1) - 1;
+
+	std::unique_ptr<std::vector<Block>> m_blocks;
+
+	Block* FindBlock(Block* block, size_t size, int parentIndex)
+	{
+		// If the block we are checking is free, and if the data could fit in the block
+		if (block->isFree && block->size >= size)
+		{
+			// There are no child blocks
+			if (block->left == nullptr && block->right == nullptr)
+			{
+				// If the half size of the block is larger than the minimum,
+				// and the data can fit in the half size
+				if (block->size / 2 >= m_minimumSize && block->size / 2 >= size)
+				{
+					block->left = &m_blocks.get()->at((2 * parentIndex) + 1);
+					block->right = &m_blocks.get()->at(2 * (parentIndex + 1));
+
+					block->left->size = block->size / 2;
+					block->right->size = block->size / 2;
+
+					block->left->offset = block->offset;
+					block->right->offset = block->offset + block->left->size;
+
+					block->left->parent = block->right->parent = block;
+				}
+				// Either the half block would hit the minimum, or the data would not fit so we stop
+				else
+				{
+					block->isFree = false;
+					return block;
+				}
+
+			}
+			Block* left = FindBlock(block->left, size, (2 * parentIndex) + 1);
+			if (left != nullptr)
+			{
+				return left;
+			}
+			return FindBlock(block->right, size, 2 * (parentIndex + 1));
+		}
+		else
+		{
+			return nullptr;
+		}
+	}
+
+	Block* FindBlockByOffset(Block* block, size_t offset)
+	{
+		if (block->left == nullptr || block->right == nullptr)
+		{
+			if (block->offset == offset)
+				return block;
+
+			return nullptr;
+		}
+
+		if (block->right->offset > offset)
+			return FindBlockByOffset(block->left, offset);
+
+		return FindBlockByOffset(block->right, offset);
+	}
+
+public:
+	LegacyBuddyAllocator()
+	{
+		m_memory = std::make_unique<std::array<char, 4096 * 1024>>();
+		m_blocks = std::make_unique<std::vector<Block>>();
+		m_blocks.get()->resize(m_numBlocks);
+		//Do we need this resize? We need to keep the blocks at constant memory places, so yes?
+		// Change this to reserve.
+		//m_blocks.reserve((1024 * 1000) / m_minimumSize);
+		//m_blocks[0].size = 1024 * 1000;
+
+		m_blocks.get()->at(0).size = 4096 * 1024;
+		//m_blocks.push_back(baseBlock);
+	}
+
+	
+	void* Alloc(size_t size)
+	{
+		Block* allocated = FindBlock(&m_blocks.get()->at(0), size, 0);
+		if (allocated == nullptr)
+		{
+			return nullptr;
+		}
+
+		return m_memory.get()->data() + allocated->offset;
+	}
+
+	void Free(void* mem)
+	{
+		ptrdiff_t offset = (char*)mem - m_memory.get()->data();
+		Block* block = FindBlockByOffset(&m_blocks.get()->at(0), offset);
+
+		block->isFree = true;
+		Block* parent = block->parent;
+		
+		if (parent->left->isFree && parent->right->isFree)
+		{
+			parent->left = nullptr;
+			parent->right = nullptr;
+		}
+
+	}
+};
 
 
 static float StressTestAlloc()
@@ -198,6 +341,148 @@ static float StressTestNew()
 	return std::chrono::duration<float, std::milli>(endTime - startTime).count();
 }
 
+static float ToMiB(size_t bytes)
+{
+	return static_cast<float>(bytes) / static_cast<float>(1 << 20);
+}
+
+// Runs the StressTestAlloc workload on 'threadCount' threads sharing one concurrent registry
+static float StressTestAllocMT(int threadCount)
+{
+	ZoneScopedC(tracy::Color::Green);
+
+	using namespace MemoryInternal;
+
+	PageRegistry<float>::Reset();
+	PageRegistry<float>::Initialize(pageSize, true);
+
+	auto workload = [](int threadIndex)
+	{
+		ZoneNamedNC(threadZone, "Worker", tracy::Color::DeepPink, true);
+
+		std::minstd_rand rng(threadIndex + 1);
+
+		std::vector<float *> allocs;
+		std::vector<int> currAllocs;
+
+		allocs.resize(allocCount, nullptr);
+		currAllocs.reserve(maxConcurrentAllocs);
+
+		for (int i = 0; i < allocCount; )
+		{
+			if (currAllocs.size() > 0)
+			{
+				// Free a random number of current allocations
+				int freeCount = rng() % (currAllocs.size() / 5 + 1);
+
+				for (int j = 0; j < freeCount && currAllocs.size() > 0; ++j)
+				{
+					int currAllocIndex = rng() % currAllocs.size();
+					int freeIdx = currAllocs[currAllocIndex];
+
+					Free<float>(allocs[freeIdx]);
+
+					allocs[freeIdx] = nullptr;
+					currAllocs.erase(currAllocs.begin() + currAllocIndex);
+				}
+			}
+
+			// Allocate a random number of floats
+			int newAllocs = rng() % ((maxConcurrentAllocs - currAllocs.size()) / 4 + 1);
+			for (int j = 0; j < newAllocs && currAllocs.size() < maxConcurrentAllocs; ++j)
+			{
+				int allocSize = (rng() % maxThreadedAllocSize) + 1;
+				int allocIdx = -1;
+
+				// Find a free slot
+				for (int k = 0; k < allocCount; ++k)
+				{
+					if (allocs[k] == nullptr)
+					{
+						allocIdx = k;
+						break;
+					}
+				}
+
+				if (allocIdx == -1)
+					continue;
+
+				float *newAlloc = Alloc<float>(allocSize);
+
+				++i;
+
+				if (newAlloc == nullptr)
+					continue;
+
+				allocs[allocIdx] = newAlloc;
+				currAllocs.push_back(allocIdx);
+
+				// Fill allocation with the allocation index for verification
+				for (int k = 0; k < allocSize; ++k)
+				{
+					newAlloc[k] = static_cast<float>(i);
+				}
+			}
+		}
+
+		// Free remaining allocations
+		for (size_t i = 0; i < currAllocs.size(); ++i)
+		{
+			Free<float>(allocs[currAllocs[i]]);
+		}
+	};
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+
+	for (int t = 0; t < threadCount; ++t)
+		threads.emplace_back(workload, t);
+
+	for (auto &thread : threads)
+		thread.join();
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	PageRegistry<float>::Reset();
+
+	return std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+// Measures the average time of a non-coalescing Free with 'liveRegions' free regions already in the registry
+static float MeasureFreeLatency(size_t liveRegions)
+{
+	ZoneScopedC(tracy::Color::Orange);
+
+	using namespace MemoryInternal;
+
+	PageRegistry<float>::Reset();
+	PageRegistry<float>::Initialize(pageSize);
+
+	// Allocate single elements in groups of four, free the first of each group to create the free regions
+	std::vector<float *> allocs;
+	allocs.resize(liveRegions * 4, nullptr);
+
+	for (size_t i = 0; i < allocs.size(); ++i)
+		allocs[i] = Alloc<float>(1);
+
+	for (size_t i = 0; i < allocs.size(); i += 4)
+		Free<float>(allocs[i]);
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	// The third of each group has allocated neighbours on both sides, so every free inserts a new region
+	for (size_t i = 2; i < allocs.size(); i += 4)
+		Free<float>(allocs[i]);
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	PageRegistry<float>::Reset();
+
+	return std::chrono::duration<float, std::nano>(endTime - startTime).count() / static_cast<float>(liveRegions);
+}
+
 
 void PerfTests::RunPoolPerfTests()
 {
@@ -205,6 +490,8 @@ void PerfTests::RunPoolPerfTests()
 
 	int iterations = 32;
 
+	size_t residentBefore = MemoryInternal::VirtualMemory::GetResidentBytes();
+
 	std::vector<float> allocTimes;
 	std::vector<float> newTimes;
 
@@ -233,4 +520,1077 @@ void PerfTests::RunPoolPerfTests()
 
 	std::cout << "Pool Alloc Average Time: " << avgAllocTime << " ms\n";
 	std::cout << "New/Delete Average Time: " << avgNewTime << " ms\n";
+
+	size_t residentAfter = MemoryInternal::VirtualMemory::GetResidentBytes();
+
+	std::cout << "Resident Memory Before: " << ToMiB(residentBefore) << " MiB\n";
+	std::cout << "Resident Memory After: " << ToMiB(residentAfter) << " MiB\n";
+}
+
+void PerfTests::RunFreeLatencyTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	std::cout << "Free latency by number of free regions:\n";
+
+	// Four elements are used per region, which must all fit in one page
+	for (size_t liveRegions = 64; liveRegions * 4 <= pageSize; liveRegions *= 2)
+	{
+		float avgFreeTime = MeasureFreeLatency(liveRegions);
+		std::cout << "  " << liveRegions << " regions: " << avgFreeTime << " ns/free\n";
+	}
+}
+
+void PerfTests::RunThreadScalingTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	int iterations = 8;
+
+	std::cout << "Concurrent pool alloc scaling (" << allocCount << " allocations per thread):\n";
+
+	// Powers of two up to, and always including, the core count
+	std::vector<int> threadCounts;
+	for (int threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+		threadCounts.push_back(threadCount);
+	threadCounts.push_back(maxThreads);
+
+	for (int threadCount : threadCounts)
+	{
+		float avgTime = 0.0f;
+
+		for (int i = 0; i < iterations; ++i)
+			avgTime += StressTestAllocMT(threadCount);
+
+		avgTime /= static_cast<float>(iterations);
+
+		float allocsPerMs = static_cast<float>(allocCount * threadCount) / avgTime;
+		std::cout << "  " << threadCount << " threads: " << avgTime << " ms, " << allocsPerMs << " allocs/ms\n";
+	}
+}
+
+void PerfTests::RunDecommitTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	using namespace MemoryInternal;
+
+	constexpr size_t spanCount = 256;
+
+	PageRegistry<float>::Reset();
+	PageRegistry<float>::Initialize(pageSize);
+
+	size_t residentStart = VirtualMemory::GetResidentBytes();
+
+	// Touch every element so the pages become resident
+	std::vector<float *> spans;
+	spans.reserve(spanCount);
+
+	for (size_t i = 0; i < spanCount; ++i)
+	{
+		float *span = Alloc<float>(pageSize);
+		if (span == nullptr)
+			break;
+
+		std::fill_n(span, pageSize, static_cast<float>(i));
+		spans.push_back(span);
+	}
+
+	size_t residentAllocated = VirtualMemory::GetResidentBytes();
+
+	for (float *span : spans)
+		Free<float>(span);
+
+	size_t residentFreed = VirtualMemory::GetResidentBytes();
+
+	// Let every free region qualify right away, then release them
+	PageRegistry<float>::SetDecommitPolicy(DEFAULT_DECOMMIT_MIN_BYTES, 0);
+	size_t released = PageRegistry<float>::ReleaseIdlePages();
+	PageRegistry<float>::SetDecommitPolicy(DEFAULT_DECOMMIT_MIN_BYTES, DEFAULT_DECOMMIT_IDLE_FREES);
+
+	size_t residentReleased = VirtualMemory::GetResidentBytes();
+
+	PageRegistry<float>::Reset();
+
+	std::cout << "Resident memory with " << spans.size() << " spans of " << pageSize << " floats:\n";
+	std::cout << "  Before allocating: " << ToMiB(residentStart) << " MiB\n";
+	std::cout << "  Allocated: " << ToMiB(residentAllocated) << " MiB\n";
+	std::cout << "  Freed: " << ToMiB(residentFreed) << " MiB\n";
+	std::cout << "  Idle pages released (" << ToMiB(released) << " MiB): " << ToMiB(residentReleased) << " MiB\n";
+}
+
+// Metadata grows with the number of allocations and free regions rather than elements, so leaving every other
+// allocation free costs the most for char, where the free region bookkeeping makes up most of it.
+template <typename T>
+static void ReportMetadataOverhead(const char *typeName)
+{
+	using namespace MemoryInternal;
+
+	constexpr size_t elementCount = 1ull << 22;
+
+	PageRegistry<T>::Reset();
+	PageRegistry<T>::Initialize(pageSize);
+
+	// Fill the storage with allocations of mixed sizes, like the stress tests do
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(1, maxAllocSize);
+
+	std::vector<T *> allocs;
+	for (size_t allocated = 0; allocated < elementCount; )
+	{
+		size_t count = sizeDist(rng);
+		allocs.push_back(Alloc<T>(count));
+		allocated += count;
+	}
+
+	// Free every other allocation to leave plenty of free regions behind
+	for (size_t i = 0; i < allocs.size(); i += 2)
+		Free<T>(allocs[i]);
+
+	size_t storageBytes = PageRegistry<T>::GetCommittedBytes();
+	size_t metadataBytes = PageRegistry<T>::GetMetadataBytes();
+
+	PageRegistry<T>::Reset();
+
+	std::cout << "  " << typeName << " (" << sizeof(T) << " B): " << ToMiB(storageBytes) << " MiB storage, "
+		<< ToMiB(metadataBytes) << " MiB metadata, "
+		<< 100.0f * static_cast<float>(metadataBytes) / static_cast<float>(storageBytes) << "%\n";
+}
+
+void PerfTests::RunMetadataOverheadTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	struct Vec4 { float x, y, z, w; };
+
+	std::cout << "Allocation metadata overhead:\n";
+	ReportMetadataOverhead<char>("char");
+	ReportMetadataOverhead<float>("float");
+	ReportMetadataOverhead<double>("double");
+	ReportMetadataOverhead<Vec4>("Vec4");
+}
+
+// Grows 'arrayCount' interleaved arrays one element at a time, like push_back on dynamic arrays
+static float GrowArrays(size_t arrayCount, size_t finalCount, bool useRealloc)
+{
+	ZoneScopedC(tracy::Color::Green);
+
+	using namespace MemoryInternal;
+
+	PageRegistry<float>::Reset();
+	PageRegistry<float>::Initialize(pageSize);
+
+	std::vector<float *> arrays(arrayCount, nullptr);
+	std::vector<size_t> capacities(arrayCount, 0);
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (size_t count = 1; count <= finalCount; ++count)
+	{
+		for (size_t i = 0; i < arrayCount; ++i)
+		{
+			if (count <= capacities[i])
+				continue;
+
+			// Grow by half the capacity each time
+			size_t capacity = std::max<size_t>(4, capacities[i] + capacities[i] / 2);
+
+			if (useRealloc)
+			{
+				arrays[i] = Realloc<float>(arrays[i], capacity);
+			}
+			else
+			{
+				float *grown = Alloc<float>(capacity);
+				if (arrays[i] != nullptr)
+				{
+					std::memcpy(grown, arrays[i], capacities[i] * sizeof(float));
+					Free<float>(arrays[i]);
+				}
+				arrays[i] = grown;
+			}
+
+			capacities[i] = capacity;
+			arrays[i][count - 1] = static_cast<float>(count);
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	PageRegistry<float>::Reset();
+
+	return std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+void PerfTests::RunReallocTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr size_t finalCount = 1 << 14;
+
+	std::cout << "Growing arrays to " << finalCount << " floats:\n";
+
+	for (size_t arrayCount : { 1, 4, 16, 64 })
+	{
+		float copyTime = GrowArrays(arrayCount, finalCount, false);
+		float reallocTime = GrowArrays(arrayCount, finalCount, true);
+
+		std::cout << "  " << arrayCount << " arrays: Alloc/copy/Free " << copyTime << " ms, Realloc " << reallocTime << " ms\n";
+	}
+}
+
+// Allocates and frees 'spanCount' spans of 'count' floats per frame, either one at a time or in batches
+static float AllocFreeFrames(size_t spanCount, size_t count, bool batched)
+{
+	ZoneScopedC(tracy::Color::Green);
+
+	using namespace MemoryInternal;
+
+	constexpr int frameCount = 64;
+
+	PageRegistry<float>::Reset();
+	PageRegistry<float>::Initialize(pageSize);
+
+	std::vector<float *> spans(spanCount, nullptr);
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		if (batched)
+		{
+			PageRegistry<float>::AllocBatch(count, spanCount, spans.data());
+			PageRegistry<float>::FreeBatch(spans.data(), spanCount);
+		}
+		else
+		{
+			for (size_t i = 0; i < spanCount; ++i)
+				spans[i] = PageRegistry<float>::Alloc(count);
+
+			// Free in a different order than allocated, like objects with varying lifetimes
+			for (size_t i = 0; i < spanCount; ++i)
+				PageRegistry<float>::Free(spans[(i * 7) % spanCount]);
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	PageRegistry<float>::Reset();
+
+	return std::chrono::duration<float, std::milli>(endTime - startTime).count() / static_cast<float>(frameCount);
+}
+
+void PerfTests::RunBatchTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr size_t spanSize = 16;
+
+	std::cout << "Per frame alloc + free of " << spanSize << " float spans:\n";
+
+	// Span counts are odd so the stride used for freeing visits every span
+	for (size_t spanCount : { 255, 1023, 4095, 16383 })
+	{
+		float singleTime = AllocFreeFrames(spanCount, spanSize, false);
+		float batchTime = AllocFreeFrames(spanCount, spanSize, true);
+
+		std::cout << "  " << spanCount << " spans: Alloc/Free " << singleTime << " ms, AllocBatch/FreeBatch " << batchTime << " ms\n";
+	}
+}
+
+// Runs a seeded alloc/free churn on a registry with the given placement policy.
+// Returns the average time per operation in nanoseconds, 'fragmentation' receives the
+// largest free region divided by the total free space once the churn is over.
+template <MemoryInternal::PlacementPolicy Policy>
+static float StressTestPlacement(float &fragmentation)
+{
+	ZoneScopedC(tracy::Color::Green);
+
+	using namespace MemoryInternal;
+	using Registry = PageRegistry<float, Policy>;
+
+	constexpr int opCount = 1 << 17;
+	constexpr size_t liveCount = 256;
+
+	Registry::Reset();
+	Registry::Initialize(pageSize);
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> sizeDist(1, maxAllocSize);
+
+	std::vector<float *> live;
+	live.reserve(liveCount);
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (int op = 0; op < opCount; ++op)
+	{
+		// Keep the number of live allocations hovering around liveCount
+		if (live.size() < liveCount / 2 || (live.size() < liveCount && (rng() & 1)))
+		{
+			live.push_back(Registry::Alloc(sizeDist(rng)));
+		}
+		else
+		{
+			size_t index = rng() % live.size();
+			Registry::Free(live[index]);
+			live[index] = live.back();
+			live.pop_back();
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	size_t largestFree = 0;
+	size_t totalFree = 0;
+
+	for (const AllocLink &region : Registry::DBG_GetOrderedFreeRegions())
+	{
+		largestFree = std::max(largestFree, region.size);
+		totalFree += region.size;
+	}
+
+	fragmentation = (totalFree > 0) ? static_cast<float>(largestFree) / static_cast<float>(totalFree) : 1.0f;
+
+	Registry::Reset();
+
+	return std::chrono::duration<float, std::nano>(endTime - startTime).count() / static_cast<float>(opCount);
+}
+
+void PerfTests::RunPlacementPolicyTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	using namespace MemoryInternal;
+
+	std::cout << "Placement policies (time per op, largest free / total free):\n";
+
+	float fragmentation = 0.0f;
+	float time = StressTestPlacement<PlacementPolicy::GoodFit>(fragmentation);
+	std::cout << "  Good fit: " << time << " ns, " << fragmentation << "\n";
+
+	time = StressTestPlacement<PlacementPolicy::BestFit>(fragmentation);
+	std::cout << "  Best fit: " << time << " ns, " << fragmentation << "\n";
+
+	time = StressTestPlacement<PlacementPolicy::FirstFit>(fragmentation);
+	std::cout << "  First fit: " << time << " ns, " << fragmentation << "\n";
+
+	time = StressTestPlacement<PlacementPolicy::NextFit>(fragmentation);
+	std::cout << "  Next fit: " << time << " ns, " << fragmentation << "\n";
+}
+
+// Returns the largest free region divided by the total free space of the float registry
+static float MeasureFragmentation()
+{
+	using namespace MemoryInternal;
+
+	size_t largestFree = 0;
+	size_t totalFree = 0;
+
+	for (const AllocLink &region : PageRegistry<float>::DBG_GetOrderedFreeRegions())
+	{
+		largestFree = std::max(largestFree, region.size);
+		totalFree += region.size;
+	}
+
+	return (totalFree > 0) ? static_cast<float>(largestFree) / static_cast<float>(totalFree) : 1.0f;
+}
+
+void PerfTests::RunCompactionTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	using namespace MemoryInternal;
+
+	constexpr size_t handleCount = 1 << 14;
+	constexpr size_t frameBudget = 100; // Microseconds
+
+	PageRegistry<float>::Reset();
+	PageRegistry<float>::Initialize(pageSize);
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(1, maxAllocSize);
+
+	std::vector<Handle<float>> handles;
+	handles.reserve(handleCount);
+
+	for (size_t i = 0; i < handleCount; ++i)
+		handles.push_back(PageRegistry<float>::AllocHandle(sizeDist(rng)));
+
+	// Free a random half to fragment the storage
+	std::shuffle(handles.begin(), handles.end(), rng);
+	for (size_t i = 0; i < handleCount / 2; ++i)
+		PageRegistry<float>::FreeHandle(handles[i]);
+
+	float fragmentationBefore = MeasureFragmentation();
+
+	size_t frames = 0;
+	size_t moved = 0;
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	while (size_t step = PageRegistry<float>::Compact(frameBudget))
+	{
+		moved += step;
+		++frames;
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	float fragmentationAfter = MeasureFragmentation();
+
+	PageRegistry<float>::Reset();
+
+	std::cout << "Compacting " << handleCount / 2 << " relocatable spans with a " << frameBudget << " us budget per frame:\n";
+	std::cout << "  Largest free / total free before: " << fragmentationBefore << "\n";
+	std::cout << "  " << frames << " frames, " << ToMiB(moved * sizeof(float)) << " MiB moved in "
+		<< std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms\n";
+	std::cout << "  Largest free / total free after: " << fragmentationAfter << "\n";
+}
+
+// Keeps 'liveCount' allocations of random sizes between 1 and 'maxSize' bytes alive, replacing a random one each op.
+// Returns the time in milliseconds, 'failures' receives the number of failed allocations.
+template <typename Allocator>
+static float ChurnBuddy(Allocator &allocator, size_t liveCount, size_t maxSize, int opCount, int &failures)
+{
+	ZoneScopedC(tracy::Color::Green);
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(1, maxSize);
+
+	std::vector<void *> live(liveCount, nullptr);
+	failures = 0;
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (int op = 0; op < opCount; ++op)
+	{
+		size_t index = rng() % liveCount;
+
+		if (live[index] != nullptr)
+			allocator.Free(live[index]);
+
+		live[index] = allocator.Alloc(sizeDist(rng));
+		if (live[index] == nullptr)
+			++failures;
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	for (void *mem : live)
+	{
+		if (mem != nullptr)
+			allocator.Free(mem);
+	}
+
+	return std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+// Allocates objects of 1 to 4 KiB until the arena is full, returns the fraction of the arena holding requested bytes
+template <typename Allocator>
+static float FillBuddy(Allocator &allocator, size_t &count)
+{
+	ZoneScopedC(tracy::Color::Green);
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(1024, 4096);
+
+	size_t requested = 0;
+	count = 0;
+
+	for (;;)
+	{
+		size_t size = sizeDist(rng);
+		if (allocator.Alloc(size) == nullptr)
+			break;
+
+		requested += size;
+		++count;
+	}
+
+	return (float)requested / (float)Allocator::GetArenaSize();
+}
+
+void PerfTests::RunBuddyTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr int opCount = 1 << 16;
+
+	// The recursive version loses track of blocks when it merges a block with a split buddy,
+	// so the comparison sticks to minimum-size blocks, which never have split buddies
+	constexpr size_t maxSize = 32 * 1024;
+
+	std::cout << "Buddy allocator churn (" << opCount << " ops, up to " << maxSize / 1024 << " KiB each):\n";
+
+	for (size_t liveCount : { 16, 64, 120 })
+	{
+		int legacyFailures = 0;
+		int failures = 0;
+
+		auto legacy = std::make_unique<LegacyBuddyAllocator>();
+		float legacyTime = ChurnBuddy(*legacy, liveCount, maxSize, opCount, legacyFailures);
+
+		auto buddy = std::make_unique<BuddyAllocator>();
+		float time = ChurnBuddy(*buddy, liveCount, maxSize, opCount, failures);
+
+		std::cout << "  " << liveCount << " live: recursive " << legacyTime << " ms (" << legacyFailures << " failed), "
+			<< "flat tree " << time << " ms (" << failures << " failed)\n";
+	}
+
+	std::cout << "Buddy metadata: recursive " << ((4096 * 1024) / (32 * 1024) * 2 - 1) * sizeof(size_t) * 6 << " bytes, "
+		<< "flat tree " << BuddyAllocator::GetMetadataBytes() << " bytes for the same 4 MiB arena, "
+		<< BasicBuddyAllocator<(1ull << 32), 1024>::GetMetadataBytes() / 1024 << " KiB for 4 GiB with 1 KiB blocks\n";
+
+	constexpr size_t arenaSize = 4096 * 1024;
+	size_t count = 0;
+
+	std::cout << "Filling a " << arenaSize / 1024 << " KiB arena with 1-4 KiB objects:\n";
+
+	{
+		auto buddy = std::make_unique<BasicBuddyAllocator<arenaSize, 32 * 1024>>();
+		float utilization = FillBuddy(*buddy, count);
+		std::cout << "  32 KiB minimum block: " << count << " objects, " << utilization * 100.0f << "% of the arena used\n";
+	}
+
+	{
+		auto buddy = std::make_unique<BasicBuddyAllocator<arenaSize, 1024>>();
+		float utilization = FillBuddy(*buddy, count);
+		std::cout << "  1 KiB minimum block: " << count << " objects, " << utilization * 100.0f << "% of the arena used\n";
+	}
+
+	// Only the pages that are touched are backed by memory
+	size_t residentBefore = MemoryInternal::VirtualMemory::GetResidentBytes();
+	{
+		auto buddy = std::make_unique<BasicBuddyAllocator<(1ull << 32), 1024>>();
+		for (int i = 0; i < 1024; ++i)
+			buddy->Alloc(4096);
+
+		size_t residentAfter = MemoryInternal::VirtualMemory::GetResidentBytes();
+		std::cout << "4 GiB arena with 4 MiB allocated: resident memory grew by " << ToMiB(residentAfter - residentBefore) << " MiB\n";
+	}
+}
+
+void PerfTests::RunBuddyChurnTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr int roundCount = 8;
+	constexpr int opsPerRound = 1 << 19;
+	constexpr size_t liveCount = 48;
+	constexpr size_t largeSize = 2 * 1024 * 1024;
+
+	auto buddy = std::make_unique<BuddyAllocator>();
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(1, 128 * 1024);
+
+	std::vector<void *> live(liveCount, nullptr);
+	int failures = 0;
+
+	std::cout << "Buddy allocator long-running churn (" << liveCount << " live blocks of up to 128 KiB):\n";
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (int round = 0; round < roundCount; ++round)
+	{
+		for (int op = 0; op < opsPerRound; ++op)
+		{
+			size_t index = rng() % liveCount;
+
+			buddy->Free(live[index]);
+			live[index] = buddy->Alloc(sizeDist(rng));
+
+			if (live[index] == nullptr)
+				++failures;
+		}
+
+		std::cout << "  " << (round + 1) * opsPerRound << " ops: fragmentation " << buddy->GetFragmentation()
+			<< ", largest free " << buddy->GetLargestFreeBlock() / 1024 << " KiB, " << failures << " failed\n";
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	for (void *block : live)
+		buddy->Free(block);
+
+	void *large = buddy->Alloc(largeSize);
+
+	std::cout << "  " << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms total, "
+		<< "2 MiB alloc after freeing the live blocks " << (large != nullptr ? "succeeded" : "failed") << "\n";
+}
+
+void PerfTests::RunSlabTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	using LargeBuddy = BasicBuddyAllocator<(64ull << 20), 1024>;
+
+	constexpr int opCount = 1 << 20;
+	constexpr size_t fillCount = 20000;
+	constexpr size_t liveCount = 1000;
+	constexpr size_t maxSize = 4096;
+
+	std::cout << "Slab allocator (objects of 1 B to " << maxSize / 1024 << " KiB):\n";
+
+	// Memory taken from the buddy to hold the same set of objects
+	{
+		std::mt19937 rng(1234);
+		std::uniform_int_distribution<size_t> sizeDist(1, maxSize);
+
+		auto smallBuddy = std::make_unique<BuddyAllocator>();
+		auto buddy = std::make_unique<LargeBuddy>();
+		auto slabBuddy = std::make_unique<LargeBuddy>();
+		auto slabs = std::make_unique<SlabAllocator<LargeBuddy>>(*slabBuddy);
+
+		size_t requested = 0;
+		size_t smallBuddyCount = 0;
+
+		for (size_t i = 0; i < fillCount; ++i)
+		{
+			size_t size = sizeDist(rng);
+
+			if (smallBuddy->Alloc(size) != nullptr)
+				++smallBuddyCount;
+
+			if (buddy->Alloc(size) != nullptr && slabs->Alloc(size) != nullptr)
+				requested += size;
+		}
+
+		size_t buddyBytes = LargeBuddy::GetArenaSize() - buddy->GetFreeBytes();
+
+		std::cout << "  " << ToMiB(BuddyAllocator::GetArenaSize()) << " MiB buddy with 32 KiB blocks: "
+			<< smallBuddyCount << " of " << fillCount << " objects fit\n";
+		std::cout << "  Buddy with 1 KiB blocks: " << ToMiB(buddyBytes) << " MiB, "
+			<< (1.0f - (float)requested / (float)buddyBytes) * 100.0f << "% wasted\n";
+		std::cout << "  Slabs: " << ToMiB(slabs->GetSlabBytes()) << " MiB in " << slabs->GetSlabCount() << " slabs, "
+			<< (1.0f - (float)requested / (float)slabs->GetSlabBytes()) * 100.0f << "% wasted\n";
+	}
+
+	// Churn through the same allocator
+	{
+		auto buddy = std::make_unique<LargeBuddy>();
+		auto slabBuddy = std::make_unique<LargeBuddy>();
+		auto slabs = std::make_unique<SlabAllocator<LargeBuddy>>(*slabBuddy);
+
+		int buddyFailures = 0;
+		int slabFailures = 0;
+
+		float buddyTime = ChurnBuddy(*buddy, liveCount, maxSize, opCount, buddyFailures);
+		float slabTime = ChurnBuddy(*slabs, liveCount, maxSize, opCount, slabFailures);
+
+		std::cout << "  " << opCount << " churn ops with " << liveCount << " live: buddy " << buddyTime * 1e6f / opCount << " ns/op, "
+			<< "slabs " << slabTime * 1e6f / opCount << " ns/op\n";
+	}
+}
+
+// Grows to 'peakCount' live blocks and shrinks back to 'troughCount' again, 'burstCount' times.
+// Returns the time in milliseconds, 'failures' receives the number of failed allocations.
+template <typename Allocator>
+static float BurstBuddy(Allocator &allocator, size_t peakCount, size_t troughCount, int burstCount, size_t maxSize, int &failures)
+{
+	ZoneScopedC(tracy::Color::Green);
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(1, maxSize);
+
+	std::vector<void *> live;
+	failures = 0;
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (int burst = 0; burst < burstCount; ++burst)
+	{
+		while (live.size() < peakCount)
+		{
+			void *mem = allocator.Alloc(sizeDist(rng));
+			if (mem == nullptr)
+				++failures;
+
+			live.push_back(mem);
+		}
+
+		std::shuffle(live.begin(), live.end(), rng);
+
+		while (live.size() > troughCount)
+		{
+			allocator.Free(live.back());
+			live.pop_back();
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	for (void *mem : live)
+		allocator.Free(mem);
+
+	return std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+void PerfTests::RunBuddyHeapTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr size_t peakCount = 2000;
+	constexpr size_t troughCount = 100;
+	constexpr int burstCount = 20;
+	constexpr size_t maxSize = 64 * 1024;
+
+	std::cout << "Bursts of up to " << peakCount << " blocks of up to " << maxSize / 1024 << " KiB, back down to " << troughCount << ":\n";
+
+	int failures = 0;
+
+	auto buddy = std::make_unique<BuddyAllocator>();
+	float buddyTime = BurstBuddy(*buddy, peakCount, troughCount, burstCount, maxSize, failures);
+	std::cout << "  Single arena: " << buddyTime << " ms, " << failures << " failed\n";
+
+	auto heap = std::make_unique<BuddyHeap>();
+	float heapTime = BurstBuddy(*heap, peakCount, troughCount, burstCount, maxSize, failures);
+	std::cout << "  Heap: " << heapTime << " ms, " << failures << " failed, " << heap->GetPeakArenaCount() << " arenas at the peak, "
+		<< heap->GetArenaCount() << " still mapped after freeing everything\n";
+
+	// With the first arena full, every allocation lands in a second arena that empties again when it is freed
+	constexpr int boundaryOpCount = 100000;
+
+	void *full = heap->Alloc(BuddyHeap::GetArenaSize());
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < boundaryOpCount; ++i)
+		heap->Free(heap->Alloc(maxSize));
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+	float boundaryTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+	heap->Free(full);
+
+	std::cout << "  Alloc and free across an arena boundary: " << boundaryTime * 1e6f / boundaryOpCount << " ns/op\n";
+}
+
+// The byte-by-byte copy StackAllocator::Push used before, kept as a baseline for RunStackTests
+static size_t PushBytewise(char* stack, size_t& top, const void* data, size_t size)
+{
+	if (top + size > STACK_SIZE)
+		return (size_t)-1;
+
+	size_t start = top;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		stack[top] = ((const char*)data)[i];
+		top++;
+	}
+
+	return start;
+}
+
+void PerfTests::RunStackTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr int frameCount = 10000;
+
+	struct Particle
+	{
+		float position[3];
+		float velocity[3];
+		float age;
+	};
+
+	std::cout << "Stack allocator, " << frameCount << " frames of pushes filling the stack:\n";
+
+	for (size_t pushSize : { 16, 256, 4096 })
+	{
+		std::vector<char> data(pushSize, 'a');
+		size_t pushCount = STACK_SIZE / pushSize;
+
+		auto stack = std::make_unique<StackAllocator>();
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			stack->Reset();
+			for (size_t i = 0; i < pushCount; ++i)
+				stack->Push(data.data(), pushSize);
+		}
+
+		std::chrono::high_resolution_clock::time_point midTime = std::chrono::high_resolution_clock::now();
+
+		size_t top = 0;
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			top = 0;
+			for (size_t i = 0; i < pushCount; ++i)
+				PushBytewise(stack->DBG_GetStack().get()->data(), top, data.data(), pushSize);
+		}
+
+		std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+		float bytes = (float)frameCount * pushCount * pushSize;
+		std::cout << "  " << pushSize << " B pushes: memcpy " << bytes / std::chrono::duration<float, std::nano>(midTime - startTime).count()
+			<< " GB/s, byte loop " << bytes / std::chrono::duration<float, std::nano>(endTime - midTime).count() << " GB/s\n";
+	}
+
+	// Building scratch objects in place instead of on the program stack and copying them
+	{
+		size_t particleCount = STACK_SIZE / sizeof(Particle);
+		auto stack = std::make_unique<StackAllocator>();
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			stack->Reset();
+			for (size_t i = 0; i < particleCount; ++i)
+			{
+				Particle particle = { { (float)i, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, (float)frame };
+				stack->Push(particle);
+			}
+		}
+
+		std::chrono::high_resolution_clock::time_point midTime = std::chrono::high_resolution_clock::now();
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			stack->Reset();
+			for (size_t i = 0; i < particleCount; ++i)
+				stack->Emplace<Particle>(Particle{ { (float)i, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, (float)frame });
+		}
+
+		std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+		float count = (float)frameCount * particleCount;
+		std::cout << "  " << sizeof(Particle) << " B objects: Push " << std::chrono::duration<float, std::nano>(midTime - startTime).count() / count
+			<< " ns each, Emplace " << std::chrono::duration<float, std::nano>(endTime - midTime).count() / count << " ns each\n";
+	}
+
+	// Padding lost to interleaving small and aligned pushes, against grouping them by alignment
+	{
+		auto stack = std::make_unique<StackAllocator>();
+		char flag = 1;
+		double value = 1.0;
+
+		for (int i = 0; i < 256; ++i)
+		{
+			stack->Push(flag);
+			stack->Push(value);
+		}
+
+		size_t interleavedPadding = stack->DBG_GetPaddingBytes();
+		stack->Reset();
+
+		for (int i = 0; i < 256; ++i)
+			stack->Push(value);
+
+		for (int i = 0; i < 256; ++i)
+			stack->Push(flag);
+
+		std::cout << "  256 char/double pairs: " << interleavedPadding << " B of padding interleaved, "
+			<< stack->DBG_GetPaddingBytes() << " B grouped\n";
+	}
+
+	// Subsystems taking scratch memory one after the other, each keeping it for the rest of the frame or only for its own scope
+	{
+		constexpr int subsystemCount = 8;
+		constexpr size_t scratchSize = 1536;
+
+		std::vector<char> scratch(scratchSize, 's');
+		auto stack = std::make_unique<StackAllocator>();
+
+		for (int i = 0; i < subsystemCount; ++i)
+			stack->Push(scratch.data(), scratchSize);
+
+		size_t framePeak = stack->DBG_GetPeakTop();
+		stack->Reset();
+
+		for (int i = 0; i < subsystemCount; ++i)
+		{
+			ScopedStack scope(*stack);
+			stack->Push(scratch.data(), scratchSize);
+		}
+
+		std::cout << "  " << subsystemCount << " subsystems with " << scratchSize << " B of scratch: peak " << framePeak
+			<< " B held until Reset, " << stack->DBG_GetPeakTop() << " B with scoped markers\n";
+	}
+}
+
+void PerfTests::RunFrameAllocatorTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr int frameCount = 10000;
+	constexpr int levelAllocCount = 16;
+	constexpr int transientAllocCount = 64;
+	constexpr size_t allocSize = 96;
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(16, allocSize);
+
+	std::cout << "Frame allocators, " << frameCount << " frames:\n";
+
+	// Level data kept for 100 frames, transient data for one
+	{
+		std::vector<void *> level;
+		std::vector<void *> transient;
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			if (frame % 100 == 0)
+			{
+				for (void *mem : level)
+					operator delete(mem);
+
+				level.clear();
+				for (int i = 0; i < levelAllocCount; ++i)
+					level.push_back(operator new(sizeDist(rng)));
+			}
+
+			for (int i = 0; i < transientAllocCount; ++i)
+				transient.push_back(operator new(sizeDist(rng)));
+
+			for (void *mem : transient)
+				operator delete(mem);
+
+			transient.clear();
+		}
+
+		for (void *mem : level)
+			operator delete(mem);
+
+		std::chrono::high_resolution_clock::time_point midTime = std::chrono::high_resolution_clock::now();
+
+		auto stack = std::make_unique<DoubleEndedStackAllocator>();
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			if (frame % 100 == 0)
+			{
+				stack->ResetBottom();
+				for (int i = 0; i < levelAllocCount; ++i)
+					stack->AllocateBottom(sizeDist(rng));
+			}
+
+			for (int i = 0; i < transientAllocCount; ++i)
+				stack->AllocateTop(sizeDist(rng));
+
+			stack->ResetTop();
+		}
+
+		std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+		std::cout << "  Level and transient data: new/delete " << std::chrono::duration<float, std::milli>(midTime - startTime).count()
+			<< " ms, double-ended stack " << std::chrono::duration<float, std::milli>(endTime - midTime).count() << " ms\n";
+	}
+
+	// Results handed from each frame to the next
+	{
+		std::vector<void *> previous;
+		std::vector<void *> current;
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			for (void *mem : previous)
+				operator delete(mem);
+
+			previous.swap(current);
+			current.clear();
+
+			for (int i = 0; i < transientAllocCount; ++i)
+				current.push_back(operator new(sizeDist(rng)));
+		}
+
+		for (void *mem : previous)
+			operator delete(mem);
+
+		for (void *mem : current)
+			operator delete(mem);
+
+		std::chrono::high_resolution_clock::time_point midTime = std::chrono::high_resolution_clock::now();
+
+		auto frameAllocator = std::make_unique<DoubleBufferedAllocator>();
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			frameAllocator->SwapBuffers();
+
+			for (int i = 0; i < transientAllocCount; ++i)
+				frameAllocator->Allocate(sizeDist(rng));
+		}
+
+		std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+		std::cout << "  Data kept for one extra frame: new/delete " << std::chrono::duration<float, std::milli>(midTime - startTime).count()
+			<< " ms, double-buffered " << std::chrono::duration<float, std::milli>(endTime - midTime).count() << " ms\n";
+	}
+}
+
+void PerfTests::RunChainedStackTests()
+{
+	ZoneScopedC(tracy::Color::Red);
+
+	constexpr int frameCount = 1000;
+	constexpr size_t pushSize = 256;
+	constexpr size_t typicalFrameBytes = 12 * 1024;
+	constexpr size_t spikeFrameBytes = 64 * 1024;
+
+	std::vector<char> data(pushSize, 'a');
+
+	auto fixed = std::make_unique<StackAllocator>();
+	auto chained = std::make_unique<ChainedStackAllocator>();
+
+	int fixedFailures = 0;
+	int chainedFailures = 0;
+	size_t maxPeak = 0;
+	size_t maxChunkCount = 0;
+
+	std::cout << "Chained stack allocator, " << frameCount << " frames of " << typicalFrameBytes / 1024 << " KiB with a "
+		<< spikeFrameBytes / 1024 << " KiB spike every 100:\n";
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		size_t frameBytes = (frame % 100 == 50) ? spikeFrameBytes : typicalFrameBytes;
+
+		for (size_t pushed = 0; pushed < frameBytes; pushed += pushSize)
+		{
+			if (chained->Push(data.data(), pushSize) == nullptr)
+				++chainedFailures;
+		}
+
+		maxChunkCount = std::max(maxChunkCount, chained->GetChunkCount());
+		chained->Reset();
+		maxPeak = std::max(maxPeak, chained->GetLastFramePeak());
+	}
+
+	std::chrono::high_resolution_clock::time_point midTime = std::chrono::high_resolution_clock::now();
+
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		size_t frameBytes = (frame % 100 == 50) ? spikeFrameBytes : typicalFrameBytes;
+
+		for (size_t pushed = 0; pushed < frameBytes; pushed += pushSize)
+		{
+			if (fixed->Push(data.data(), pushSize) == (size_t)-1)
+				++fixedFailures;
+		}
+
+		fixed->Reset();
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+	std::cout << "  Fixed " << STACK_SIZE / 1024 << " KiB stack: " << std::chrono::duration<float, std::milli>(endTime - midTime).count()
+		<< " ms, " << fixedFailures << " failed pushes\n";
+	std::cout << "  Chained: " << std::chrono::duration<float, std::milli>(midTime - startTime).count() << " ms, "
+		<< chainedFailures << " failed pushes, up to " << maxChunkCount << " chunks in a frame\n";
+	std::cout << "  Peak frame " << maxPeak / 1024 << " KiB, last frame " << chained->GetLastFramePeak() / 1024 << " KiB, "
+		<< chained->GetReservedBytes() / 1024 << " KiB held in " << chained->GetChunkCount() << " chunk and "
+		<< chained->GetPooledChunkCount() << " pooled\n";
 }
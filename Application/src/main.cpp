@@ -147,6 +147,81 @@ int main()
                 PerfTests::RunPoolPerfTests();
 			}
 
+            if (ImGui::Button("Run Free Latency Tests"))
+            {
+                PerfTests::RunFreeLatencyTests();
+            }
+
+            if (ImGui::Button("Run Thread Scaling Tests"))
+            {
+                PerfTests::RunThreadScalingTests();
+            }
+
+            if (ImGui::Button("Run Decommit Tests"))
+            {
+                PerfTests::RunDecommitTests();
+            }
+
+            if (ImGui::Button("Run Metadata Overhead Tests"))
+            {
+                PerfTests::RunMetadataOverheadTests();
+            }
+
+            if (ImGui::Button("Run Realloc Tests"))
+            {
+                PerfTests::RunReallocTests();
+            }
+
+            if (ImGui::Button("Run Batch Tests"))
+            {
+                PerfTests::RunBatchTests();
+            }
+
+            if (ImGui::Button("Run Placement Policy Tests"))
+            {
+                PerfTests::RunPlacementPolicyTests();
+            }
+
+            if (ImGui::Button("Run Compaction Tests"))
+            {
+                PerfTests::RunCompactionTests();
+            }
+
+            if (ImGui::Button("Run Buddy Tests"))
+            {
+                PerfTests::RunBuddyTests();
+            }
+
+            if (ImGui::Button("Run Buddy Churn Tests"))
+            {
+                PerfTests::RunBuddyChurnTests();
+            }
+
+            if (ImGui::Button("Run Slab Tests"))
+            {
+                PerfTests::RunSlabTests();
+            }
+
+            if (ImGui::Button("Run Buddy Heap Tests"))
+            {
+                PerfTests::RunBuddyHeapTests();
+            }
+
+            if (ImGui::Button("Run Stack Tests"))
+            {
+                PerfTests::RunStackTests();
+            }
+
+            if (ImGui::Button("Run Frame Allocator Tests"))
+            {
+                PerfTests::RunFrameAllocatorTests();
+            }
+
+            if (ImGui::Button("Run Chained Stack Tests"))
+            {
+                PerfTests::RunChainedStackTests();
+            }
+
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
             ImGui::End();
         }
@@ -0,0 +1,218 @@
+#include "../../../Application/inc/BuddyAllocator.hpp"
+#include "../../../Application/inc/BuddyHeap.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+
+constexpr size_t ARENA_SIZE = 4096 * 1024;
+constexpr size_t MIN_BLOCK_SIZE = 32 * 1024;
+
+
+// Tests
+
+TEST(BuddyTest, AllocFree)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+
+	char *whole = (char *)buddy->Alloc(ARENA_SIZE);
+	ASSERT_TRUE(whole != nullptr);
+	ASSERT_EQ(buddy->Alloc(1), nullptr);
+
+	buddy->Free(whole);
+
+	// Freed memory is handed out again
+	char *alloc = (char *)buddy->Alloc(75 * 1000);
+	ASSERT_EQ(alloc, whole);
+
+	buddy->Free(alloc);
+	ASSERT_EQ(buddy->Alloc(ARENA_SIZE), whole);
+}
+
+TEST(BuddyTest, InvalidRequests)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+
+	ASSERT_EQ(buddy->Alloc(0), nullptr);
+	ASSERT_EQ(buddy->Alloc(ARENA_SIZE + 1), nullptr);
+
+	char *alloc = (char *)buddy->Alloc(MIN_BLOCK_SIZE * 2);
+	ASSERT_TRUE(alloc != nullptr);
+
+	// Frees of pointers that are not allocated blocks are ignored
+	buddy->Free(nullptr);
+	buddy->Free(alloc + MIN_BLOCK_SIZE);
+	buddy->Free(alloc + MIN_BLOCK_SIZE * 4);
+
+	buddy->Free(alloc);
+	buddy->Free(alloc);
+
+	ASSERT_EQ(buddy->Alloc(ARENA_SIZE), alloc);
+}
+
+TEST(BuddyTest, BlocksAreAlignedAndDisjoint)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+
+	char *base = (char *)buddy->Alloc(ARENA_SIZE);
+	buddy->Free(base);
+
+	std::vector<std::pair<char *, size_t>> blocks;
+	size_t sizes[] = { 36 * 1000, 128 * 1000, 1, 200 * 1000, 30 * 1000, 100 * 1000, 512 * 1024 };
+
+	for (size_t size : sizes)
+	{
+		char *alloc = (char *)buddy->Alloc(size);
+		ASSERT_TRUE(alloc != nullptr);
+
+		// Blocks are powers of two of at least the minimum size, aligned to their own size
+		size_t blockSize = std::max(MIN_BLOCK_SIZE, std::bit_ceil(size));
+		ASSERT_EQ((size_t)(alloc - base) % blockSize, 0ULL);
+
+		for (auto &[other, otherSize] : blocks)
+			ASSERT_TRUE(alloc + blockSize <= other || other + otherSize <= alloc);
+
+		blocks.push_back({ alloc, blockSize });
+	}
+}
+
+TEST(BuddyTest, BuddiesMergeBackToWholeArena)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+
+	// Fill the arena with minimum size blocks and free them in random order
+	std::vector<void *> blocks;
+	for (size_t i = 0; i < ARENA_SIZE / MIN_BLOCK_SIZE; ++i)
+	{
+		blocks.push_back(buddy->Alloc(MIN_BLOCK_SIZE));
+		ASSERT_TRUE(blocks.back() != nullptr);
+	}
+
+	ASSERT_EQ(buddy->Alloc(1), nullptr);
+
+	std::shuffle(blocks.begin(), blocks.end(), std::mt19937(42));
+	for (void *block : blocks)
+		buddy->Free(block);
+
+	ASSERT_TRUE(buddy->Alloc(ARENA_SIZE) != nullptr);
+}
+
+TEST(BuddyTest, LargeAllocSucceedsAfterChurn)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<size_t> sizeDist(1, 4 * MIN_BLOCK_SIZE);
+
+	// Many small alloc/free cycles with a shifting set of live blocks
+	std::vector<void *> live(48, nullptr);
+	for (int i = 0; i < 1000000; ++i)
+	{
+		size_t index = rng() % live.size();
+
+		buddy->Free(live[index]);
+		live[index] = buddy->Alloc(sizeDist(rng));
+	}
+
+	ASSERT_GT(buddy->GetFragmentation(), 0.0f);
+
+	for (void *block : live)
+		buddy->Free(block);
+
+	// Every buddy pair merged all the way back up
+	ASSERT_EQ(buddy->GetFreeBytes(), ARENA_SIZE);
+	ASSERT_EQ(buddy->GetLargestFreeBlock(), ARENA_SIZE);
+	ASSERT_EQ(buddy->GetFragmentation(), 0.0f);
+
+	void *first = buddy->Alloc(2 * 1024 * 1024);
+	void *second = buddy->Alloc(2 * 1024 * 1024);
+	ASSERT_TRUE(first != nullptr && second != nullptr);
+}
+
+TEST(BuddyTest, ConfigurableArenaAndBlockSize)
+{
+	constexpr size_t largeArena = 1ull << 32;
+	constexpr size_t smallBlock = 1024;
+
+	using LargeBuddy = BasicBuddyAllocator<largeArena, smallBlock>;
+	static_assert(LargeBuddy::GetArenaSize() == largeArena && LargeBuddy::GetMinimumBlockSize() == smallBlock);
+
+	auto buddy = std::make_unique<LargeBuddy>();
+	ASSERT_EQ(buddy->GetFreeBytes(), largeArena);
+
+	// Small requests are rounded up to the small minimum block, not to 32 KiB
+	char *first = (char *)buddy->Alloc(1);
+	char *second = (char *)buddy->Alloc(700);
+	char *third = (char *)buddy->Alloc(3000);
+	ASSERT_TRUE(first != nullptr && second != nullptr && third != nullptr);
+	ASSERT_EQ(second - first, (ptrdiff_t)smallBlock);
+	ASSERT_EQ(third - first, (ptrdiff_t)(4 * smallBlock));
+	ASSERT_EQ(buddy->GetFreeBytes(), largeArena - 6 * smallBlock);
+
+	// Blocks are usable memory
+	memset(third, 0xAB, 3000);
+
+	char *half = (char *)buddy->Alloc(largeArena / 2);
+	ASSERT_EQ(half, first + largeArena / 2);
+	ASSERT_EQ(buddy->Alloc(largeArena / 2), nullptr);
+
+	buddy->Free(first);
+	buddy->Free(second);
+	buddy->Free(third);
+	buddy->Free(half);
+
+	ASSERT_EQ(buddy->Alloc(largeArena), first);
+}
+
+TEST(BuddyTest, HeapGrowsAndShrinks)
+{
+	auto heap = std::make_unique<BuddyHeap>();
+	ASSERT_EQ(heap->GetArenaCount(), 0ULL);
+
+	// More than one arena's worth of blocks maps more arenas
+	std::vector<char *> blocks;
+	for (size_t i = 0; i < 3 * ARENA_SIZE / (ARENA_SIZE / 4); ++i)
+	{
+		blocks.push_back((char *)heap->Alloc(ARENA_SIZE / 4));
+		ASSERT_TRUE(blocks.back() != nullptr);
+	}
+
+	ASSERT_EQ(heap->GetArenaCount(), 3ULL);
+	ASSERT_EQ(heap->GetFreeBytes(), 0ULL);
+
+	// Whole arenas still fit beside them
+	char *whole = (char *)heap->Alloc(ARENA_SIZE);
+	ASSERT_TRUE(whole != nullptr);
+	ASSERT_EQ(heap->GetArenaCount(), 4ULL);
+	ASSERT_EQ(heap->Alloc(ARENA_SIZE + 1), nullptr);
+
+	// Pointers outside the heap are ignored
+	char outside = 0;
+	heap->Free(&outside);
+	heap->Free(whole + MIN_BLOCK_SIZE);
+	ASSERT_EQ(heap->GetArenaCount(), 4ULL);
+
+	// The first arena to become fully free stays mapped as a spare, so going back and forth doesn't remap it
+	heap->Free(whole);
+	ASSERT_EQ(heap->GetArenaCount(), 4ULL);
+	ASSERT_EQ(heap->Alloc(ARENA_SIZE), whole);
+
+	heap->Free(whole);
+	ASSERT_EQ(heap->GetArenaCount(), 4ULL);
+
+	// Any further fully free arenas are unmapped
+	for (size_t i = 4; i < blocks.size(); ++i)
+		heap->Free(blocks[i]);
+
+	ASSERT_EQ(heap->GetArenaCount(), 2ULL);
+	ASSERT_EQ(heap->GetPeakArenaCount(), 4ULL);
+
+	for (size_t i = 0; i < 4; ++i)
+		heap->Free(blocks[i]);
+
+	ASSERT_EQ(heap->GetArenaCount(), 1ULL);
+	ASSERT_EQ(heap->GetFreeBytes(), ARENA_SIZE);
+}
@@ -2,6 +2,8 @@
 
 #include "../../../Application/inc/PageRegistry.hpp"
 #include <gtest/gtest.h>
+#include <thread>
+#include <random>
 
 #pragma warning(disable: 6262) // Disable stack size warning
 
@@ -14,75 +16,96 @@ struct TestStruct
 	char c;
 };
 
+struct LifetimeStruct
+{
+	static inline int constructed = 0;
+	static inline int destroyed = 0;
+
+	int value;
+	std::string name;
+
+	LifetimeStruct() : value(-1), name("default") { ++constructed; }
+	LifetimeStruct(int v, const std::string &n) : value(v), name(n) { ++constructed; }
+	~LifetimeStruct() { ++destroyed; }
+};
+
+struct PrivateStruct
+{
+	int a;
+};
+
+template <>
+struct MemoryInternal::SharesRegistry<PrivateStruct> : std::false_type { };
+
 
 // Helper functions
 
 template <typename T>
-bool IsAddressAllocated(T *addr)
+size_t GetAllocatedSize(T *addr)
 {
 	using namespace MemoryInternal;
 
-	const auto &allocMap = PageRegistry<T>::DBG_GetAllocMap();
 	const auto &pageStorage = PageRegistry<T>::DBG_GetPageStorage();
 
+	if (addr < pageStorage.data() || addr >= pageStorage.data() + pageStorage.size())
+		return 0;
+
 	size_t addrOffset = addr - pageStorage.data();
 
 	// Step back from addrOffset to find the allocation start
-	size_t i = addrOffset;
-
-	while (i < allocMap.size())
+	for (size_t i = addrOffset + 1; i-- > 0;)
 	{
-		if (allocMap[i] == NULL_INDEX)
-		{
-			--i;
+		size_t count = PageRegistry<T>::GetAllocatedCount(pageStorage.data() + i);
+		if (count == 0)
 			continue;
-		}
 
-		if (addrOffset < i + allocMap[i])
-		{
-			return true;
-		}
+		if (addrOffset < i + count)
+			return count;
 		else
-		{
-			return false; // Not found
-		}
+			return 0; // Not found
 	}
 
-	return false;
+	return 0;
 }
 
 template <typename T>
-size_t GetAllocatedSize(T *addr)
+bool IsAddressAllocated(T *addr)
 {
-	using namespace MemoryInternal;
+	return GetAllocatedSize<T>(addr) != 0;
+}
 
-	const auto &allocMap = PageRegistry<T>::DBG_GetAllocMap();
-	const auto &pageStorage = PageRegistry<T>::DBG_GetPageStorage();
+// Leaves holes of 120, 98 and 101 elements in a registry using 'Policy', then
+// returns the element offset a request for 97 elements is placed at
+template <MemoryInternal::PlacementPolicy Policy>
+size_t PlaceAmongHoles()
+{
+	using namespace MemoryInternal;
+	using Registry = PageRegistry<int, Policy>;
 
-	size_t addrOffset = addr - pageStorage.data();
+	Registry::Reset();
 
-	// Step back from addrOffset to find the allocation start
-	size_t i = addrOffset;
+	int *holes[3];
+	int *spacers[3];
+	size_t sizes[3] = { 120, 98, 101 };
 
-	while (i < allocMap.size())
+	for (int i = 0; i < 3; ++i)
 	{
-		if (allocMap[i] == NULL_INDEX)
-		{
-			--i;
-			continue;
-		}
-
-		if (addrOffset < i + allocMap[i])
-		{
-			return allocMap[i];
-		}
-		else
-		{
-			return 0; // Not found
-		}
+		holes[i] = Registry::Alloc(sizes[i]);
+		spacers[i] = Registry::Alloc(8);
 	}
 
-	return 0;
+	for (int i = 0; i < 3; ++i)
+		Registry::Free(holes[i]);
+
+	int *placed = Registry::Alloc(97);
+	size_t offset = placed - Registry::DBG_GetPageStorage().data();
+
+	Registry::Free(placed);
+	for (int i = 0; i < 3; ++i)
+		Registry::Free(spacers[i]);
+
+	Registry::Reset();
+	return offset;
 }
 
 
@@ -207,8 +230,8 @@ TEST(PoolTest, AllocFreeEdgeCases)
 	int *allocZero = Alloc<int>(0);
 	ASSERT_EQ(allocZero, nullptr);
 
-	// Allocating more than max size
-	int *allocTooLarge = Alloc<int>(MemoryInternal::PageRegistry<int>::DBG_GetPageStorage().size() + 1);
+	// Allocating more than the registry can ever grow to
+	int *allocTooLarge = Alloc<int>(MemoryInternal::PageRegistry<int>::DBG_GetReservedCount() + 1);
 	ASSERT_EQ(allocTooLarge, nullptr);
 
 	ASSERT_EQ(Free<int>(allocInt), 0);
@@ -279,6 +302,844 @@ TEST(PoolTest, StructAlloc)
 	ASSERT_EQ(Free<TestStruct>(allocStruct), 0);
 }
 
+TEST(PoolTest, SharedRegistryPerLayout)
+{
+	using namespace MemoryInternal;
+
+	static_assert(std::is_same_v<RegistrySlot<int>, RegistrySlot<float>>);
+	static_assert(std::is_same_v<RegistrySlot<LifetimeStruct>, LifetimeStruct>);
+	static_assert(std::is_same_v<RegistrySlot<PrivateStruct>, PrivateStruct>);
+
+	PageRegistry<int>::Reset();
+	PageRegistry<PrivateStruct>::Reset();
+
+	// Types of the same size and alignment are served from one storage
+	int *allocInt = Alloc<int>(16);
+	float *allocFloat = Alloc<float>(16);
+
+	ASSERT_TRUE(allocInt != nullptr && allocFloat != nullptr);
+	ASSERT_EQ(reinterpret_cast<void *>(PageRegistry<int>::DBG_GetPageStorage().data()),
+		reinterpret_cast<void *>(PageRegistry<float>::DBG_GetPageStorage().data()));
+	ASSERT_EQ(reinterpret_cast<void *>(allocInt + 16), reinterpret_cast<void *>(allocFloat));
+
+	// Space freed by one type is reused by the other
+	ASSERT_EQ(Free<int>(allocInt), 0);
+	float *reused = Alloc<float>(16);
+	ASSERT_EQ(reinterpret_cast<void *>(reused), reinterpret_cast<void *>(allocInt));
+	ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(reinterpret_cast<int *>(reused)), 16ULL);
+
+	// Opted out types keep a registry of their own
+	PrivateStruct *allocPrivate = Alloc<PrivateStruct>(16);
+	ASSERT_TRUE(allocPrivate != nullptr);
+	ASSERT_NE(reinterpret_cast<void *>(PageRegistry<PrivateStruct>::DBG_GetPageStorage().data()),
+		reinterpret_cast<void *>(PageRegistry<int>::DBG_GetPageStorage().data()));
+
+	ASSERT_EQ(Free<float>(allocFloat), 0);
+	ASSERT_EQ(Free<float>(reused), 0);
+	ASSERT_EQ(Free<PrivateStruct>(allocPrivate), 0);
+
+	PageRegistry<int>::Reset();
+	PageRegistry<PrivateStruct>::Reset();
+}
+
+TEST(PoolTest, AlignedAlloc)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<char>::Reset();
+	PageRegistry<TestStruct>::Reset();
+
+	// Misalign the start of the free region first
+	char *prefix = Alloc<char>(3);
+
+	char *cacheLine = AllocAligned<char>(100, 64);
+	ASSERT_TRUE(cacheLine != nullptr);
+	ASSERT_EQ(reinterpret_cast<uintptr_t>(cacheLine) % 64, 0ULL);
+	ASSERT_EQ(PageRegistry<char>::GetAllocatedCount(cacheLine), 100ULL);
+
+	char *page = AllocAligned<char>(10, 4096);
+	ASSERT_TRUE(page != nullptr);
+	ASSERT_EQ(reinterpret_cast<uintptr_t>(page) % 4096, 0ULL);
+
+	// Sizes that are not a power of two still land on aligned addresses
+	TestStruct *structs = AllocAligned<TestStruct>(5, 64);
+	ASSERT_TRUE(structs != nullptr);
+	ASSERT_EQ(reinterpret_cast<uintptr_t>(structs) % 64, 0ULL);
+
+	// The padding in front of aligned spans stays usable
+	char *filler = Alloc<char>(8);
+	ASSERT_TRUE(filler >= prefix + 3 && filler + 8 <= cacheLine);
+
+	ASSERT_EQ(AllocAligned<char>(1, 48), nullptr);
+	ASSERT_EQ(AllocAligned<char>(1, VirtualMemory::GetPageSize() * 2), nullptr);
+
+	ASSERT_EQ(Free<char>(cacheLine), 0);
+	ASSERT_EQ(Free<char>(filler), 0);
+	ASSERT_EQ(Free<char>(page), 0);
+	ASSERT_EQ(Free<char>(prefix), 0);
+	ASSERT_EQ(Free<TestStruct>(structs), 0);
+
+	// Padding and spans coalesce back into a single region
+	auto regions = PageRegistry<char>::DBG_GetOrderedFreeRegions();
+	ASSERT_EQ(regions.size(), 1ULL);
+	ASSERT_EQ(regions[0].size, PageRegistry<char>::DBG_GetPageStorage().size());
+
+	PageRegistry<char>::Reset();
+	PageRegistry<TestStruct>::Reset();
+}
+
+TEST(PoolTest, ReallocInPlace)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<int>::Reset();
+
+	int *alloc = Alloc<int>(16);
+	for (int i = 0; i < 16; ++i)
+		alloc[i] = i;
+
+	// Grows into the free region right after it
+	int *grown = Realloc<int>(alloc, 64);
+	ASSERT_EQ(grown, alloc);
+	ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(grown), 64ULL);
+
+	// Shrinking hands the tail back for the next allocation
+	int *shrunk = Realloc<int>(grown, 8);
+	ASSERT_EQ(shrunk, alloc);
+	ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(shrunk), 8ULL);
+
+	// Regrown elements are zeroed rather than keeping their old values
+	int *regrown = Realloc<int>(shrunk, 16);
+	ASSERT_EQ(regrown, alloc);
+	for (int i = 8; i < 16; ++i)
+		ASSERT_EQ(regrown[i], 0);
+
+	shrunk = Realloc<int>(regrown, 8);
+
+	int *blocker = Alloc<int>(4);
+	ASSERT_EQ(blocker, alloc + 8);
+
+	// Blocked allocations move as a last resort
+	int *moved = Realloc<int>(shrunk, 32);
+	ASSERT_TRUE(moved != nullptr && moved != alloc);
+	for (int i = 0; i < 32; ++i)
+		ASSERT_EQ(moved[i], i < 8 ? i : 0);
+
+	ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(alloc), 0ULL);
+
+	// Allocations reaching the end of the storage grow into new pages
+	size_t pageCount = PageRegistry<int>::DBG_GetPageStorage().size();
+	int *last = Alloc<int>(64);
+	ASSERT_EQ(last, moved + 32);
+
+	size_t lastOffset = last - PageRegistry<int>::DBG_GetPageStorage().data();
+	ASSERT_EQ(Realloc<int>(last, pageCount - lastOffset), last);
+	ASSERT_EQ(PageRegistry<int>::DBG_GetPageStorage().size(), pageCount);
+
+	int *extended = Realloc<int>(last, pageCount);
+	ASSERT_EQ(extended, last);
+	ASSERT_GT(PageRegistry<int>::DBG_GetPageStorage().size(), pageCount);
+
+	ASSERT_EQ(PageRegistry<int>::Resize(blocker, 0), -4);
+	ASSERT_EQ(PageRegistry<int>::Resize(alloc, 4), -3);
+
+	ASSERT_EQ(Free<int>(moved), 0);
+	ASSERT_EQ(Free<int>(blocker), 0);
+	ASSERT_EQ(Free<int>(extended), 0);
+
+	auto regions = PageRegistry<int>::DBG_GetOrderedFreeRegions();
+	ASSERT_EQ(regions.size(), 1ULL);
+
+	// Reallocating nothing value-initializes a new allocation like growing one does
+	int *stale = Alloc<int>(16);
+	std::fill_n(stale, 16, 7);
+	ASSERT_EQ(Free<int>(stale), 0);
+
+	int *fresh = Realloc<int>(nullptr, 16);
+	ASSERT_EQ(fresh, stale);
+	for (int i = 0; i < 16; ++i)
+		ASSERT_EQ(fresh[i], 0);
+
+	ASSERT_EQ(Free<int>(fresh), 0);
+
+	PageRegistry<int>::Reset();
+}
+
+TEST(PoolTest, BatchAllocFree)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<int>::Reset();
+
+	constexpr size_t spanCount = 1000;
+
+	// More spans than fit in the first page
+	std::vector<int *> spans(spanCount);
+	ASSERT_EQ(AllocBatch<int>(16, spanCount, spans.data()), spanCount);
+
+	for (size_t i = 0; i < spanCount; ++i)
+	{
+		ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(spans[i]), 16ULL);
+		std::fill_n(spans[i], 16, static_cast<int>(i));
+	}
+
+	for (size_t i = 0; i < spanCount; ++i)
+		ASSERT_EQ(spans[i][15], static_cast<int>(i));
+
+	// Free half of them in random order, with duplicates and null entries mixed in
+	std::vector<int *> toFree(spans.begin(), spans.begin() + spanCount / 2);
+	toFree.push_back(spans[0]);
+	toFree.push_back(nullptr);
+	toFree.push_back(spans[0] + 1);
+	std::shuffle(toFree.begin(), toFree.end(), std::mt19937(42));
+
+	ASSERT_EQ(PageRegistry<int>::FreeBatch(toFree.data(), toFree.size()), spanCount / 2);
+	ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(spans[0]), 0ULL);
+	ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(spans[spanCount / 2]), 16ULL);
+
+	// The freed spans were merged into one region
+	auto regions = PageRegistry<int>::DBG_GetOrderedFreeRegions();
+	ASSERT_EQ(regions.front().offset, 0ULL);
+	ASSERT_EQ(regions.front().size, 16ULL * (spanCount / 2));
+
+	ASSERT_EQ(FreeBatch<int>(spans.data() + spanCount / 2, spanCount / 2), spanCount / 2);
+
+	regions = PageRegistry<int>::DBG_GetOrderedFreeRegions();
+	ASSERT_EQ(regions.size(), 1ULL);
+
+	PageRegistry<int>::Reset();
+}
+
+TEST(PoolTest, PlacementPolicies)
+{
+	using namespace MemoryInternal;
+
+	static_assert(!std::is_same_v<RegistrySlot<int, PlacementPolicy::GoodFit>, RegistrySlot<int, PlacementPolicy::BestFit>>);
+
+	// Lowest address
+	ASSERT_EQ(PlaceAmongHoles<PlacementPolicy::FirstFit>(), 0ULL);
+
+	// Tightest hole
+	ASSERT_EQ(PlaceAmongHoles<PlacementPolicy::BestFit>(), 128ULL);
+
+	// Good fit rounds the request up to the next size class, 100 to 103 elements
+	ASSERT_EQ(PlaceAmongHoles<PlacementPolicy::GoodFit>(), 234ULL);
+
+	// and takes the lowest addressed hole of that class, not the most recently freed one
+	{
+		using Registry = PageRegistry<int, PlacementPolicy::GoodFit>;
+		Registry::Reset();
+
+		int *low = Registry::Alloc(101);
+		int *spacer = Registry::Alloc(8);
+		int *high = Registry::Alloc(102);
+		int *tail = Registry::Alloc(8);
+
+		Registry::Free(low);
+		Registry::Free(high);
+
+		int *placed = Registry::Alloc(97);
+		ASSERT_EQ(placed, low);
+
+		Registry::Free(placed);
+		Registry::Free(spacer);
+		Registry::Free(tail);
+		Registry::Reset();
+	}
+
+	// Next fit continues after the last allocation
+	ASSERT_EQ(PlaceAmongHoles<PlacementPolicy::NextFit>(), 343ULL);
+}
+
+TEST(PoolTest, CompactRelocatesHandles)
+{
+	using namespace MemoryInternal;
+
+	constexpr size_t spanCount = 16;
+	constexpr size_t spanSize = 256;
+
+	// Room for exactly 16 spans, so fragmented storage cannot grow its way out
+	PageRegistry<int>::Reset();
+	PageRegistry<int>::Initialize(1024, false, spanCount * spanSize * sizeof(int));
+
+	std::vector<Handle<int>> handles;
+	for (size_t i = 0; i < spanCount - 1; ++i)
+	{
+		handles.push_back(PageRegistry<int>::AllocHandle(spanSize));
+		ASSERT_FALSE(handles.back().IsNull());
+		std::fill_n(handles.back().Get(), spanSize, static_cast<int>(i));
+	}
+
+	int *pinned = Alloc<int>(spanSize);
+	ASSERT_TRUE(pinned != nullptr);
+	std::fill_n(pinned, spanSize, -1);
+
+	// Relocatable allocations can only be freed through their handle
+	ASSERT_EQ(Free<int>(handles[1].Get()), -4);
+
+	for (size_t i = 0; i < handles.size(); i += 2)
+		ASSERT_EQ(PageRegistry<int>::FreeHandle(handles[i]), 0);
+
+	ASSERT_EQ(handles[0].Get(), nullptr);
+	ASSERT_EQ(PageRegistry<int>::FreeHandle(handles[0]), -2);
+
+	// Half the storage is free, but only in holes of a single span
+	ASSERT_EQ(Alloc<int>(spanSize * 2), nullptr);
+
+	// A zero budget still makes progress
+	ASSERT_EQ(PageRegistry<int>::Compact(0), spanSize);
+
+	size_t moved = 0;
+	while (size_t step = PageRegistry<int>::Compact(1000))
+		moved += step;
+
+	ASSERT_EQ(moved, spanSize * (spanCount / 2 - 2));
+
+	// The pinned allocation stayed put, the relocated ones kept their contents
+	for (size_t i = 1; i < handles.size(); i += 2)
+	{
+		int *span = handles[i].Get();
+		ASSERT_TRUE(span < pinned);
+		ASSERT_EQ(span[0], static_cast<int>(i));
+		ASSERT_EQ(span[spanSize - 1], static_cast<int>(i));
+	}
+
+	ASSERT_EQ(pinned[0], -1);
+
+	auto regions = PageRegistry<int>::DBG_GetOrderedFreeRegions();
+	ASSERT_EQ(regions.size(), 1ULL);
+	ASSERT_EQ(regions[0].size, spanSize * (spanCount / 2));
+
+	int *large = Alloc<int>(spanSize * 2);
+	ASSERT_TRUE(large != nullptr);
+
+	ASSERT_EQ(Free<int>(large), 0);
+	ASSERT_EQ(Free<int>(pinned), 0);
+	for (size_t i = 1; i < handles.size(); i += 2)
+		ASSERT_EQ(PageRegistry<int>::FreeHandle(handles[i]), 0);
+
+	PageRegistry<int>::Reset();
+}
+
+TEST(PoolTest, HandleMetadata)
+{
+	using namespace MemoryInternal;
+
+	constexpr size_t handleCount = 1000;
+
+	PageRegistry<int>::Reset();
+	PageRegistry<int>::Initialize(1024);
+	size_t metadataBytes = PageRegistry<int>::GetMetadataBytes();
+
+	std::vector<Handle<int>> handles;
+	for (size_t i = 0; i < handleCount; ++i)
+	{
+		handles.push_back(PageRegistry<int>::AllocHandle(1));
+		ASSERT_FALSE(handles.back().IsNull());
+	}
+
+	// Every handle costs at least its entry, its map node and its count, at most three quarters full
+	size_t handleBytes = 3 * sizeof(size_t) + (2 * sizeof(size_t) + sizeof(void *)) + 2 * sizeof(size_t) * 4 / 3;
+	ASSERT_GE(PageRegistry<int>::GetMetadataBytes(), metadataBytes + handleCount * handleBytes);
+
+	for (Handle<int> &handle : handles)
+		ASSERT_EQ(PageRegistry<int>::FreeHandle(handle), 0);
+
+	PageRegistry<int>::Reset();
+}
+
+TEST(PoolTest, ConstructOnAllocDestroyOnFree)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<LifetimeStruct>::Reset();
+	LifetimeStruct::constructed = 0;
+	LifetimeStruct::destroyed = 0;
+
+	// Initializing the registry must not construct anything
+	PageRegistry<LifetimeStruct>::Initialize(DEFAULT_PAGE_SIZE);
+	ASSERT_EQ(LifetimeStruct::constructed, 0);
+
+	LifetimeStruct *defaulted = Alloc<LifetimeStruct>(3);
+	ASSERT_TRUE(defaulted != nullptr);
+	ASSERT_EQ(LifetimeStruct::constructed, 3);
+	ASSERT_EQ(defaulted[2].name, "default");
+
+	LifetimeStruct *custom = New<LifetimeStruct>(5, 42, std::string("custom"));
+	ASSERT_TRUE(custom != nullptr);
+	ASSERT_EQ(LifetimeStruct::constructed, 8);
+
+	for (int i = 0; i < 5; ++i)
+	{
+		ASSERT_EQ(custom[i].value, 42);
+		ASSERT_EQ(custom[i].name, "custom");
+	}
+
+	// Moved elements keep their values, added ones are default constructed
+	custom = Realloc<LifetimeStruct>(custom, 4);
+	ASSERT_EQ(LifetimeStruct::destroyed, 1);
+
+	custom = Realloc<LifetimeStruct>(custom, 6);
+	ASSERT_EQ(custom[3].name, "custom");
+	ASSERT_EQ(custom[5].name, "default");
+
+	ASSERT_EQ(Delete<LifetimeStruct>(custom), 0);
+	ASSERT_EQ(LifetimeStruct::destroyed, 7);
+
+	ASSERT_EQ(Free<LifetimeStruct>(defaulted), 0);
+	ASSERT_EQ(LifetimeStruct::destroyed, 10);
+
+	// Failed frees must not destroy anything
+	ASSERT_EQ(Delete<LifetimeStruct>(custom), -3);
+	ASSERT_EQ(LifetimeStruct::destroyed, 10);
+
+	// Reset destroys whatever is still alive
+	(void)New<LifetimeStruct>(2, 7, std::string("leaked"));
+	PageRegistry<LifetimeStruct>::Reset();
+	ASSERT_EQ(LifetimeStruct::destroyed, 12);
+	ASSERT_EQ(LifetimeStruct::constructed, 12);
+}
+
+TEST(PoolTest, ResetOnlyDestroysConstructedAllocations)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<LifetimeStruct>::Reset();
+	LifetimeStruct::constructed = 0;
+	LifetimeStruct::destroyed = 0;
+
+	PageRegistry<LifetimeStruct>::Initialize(DEFAULT_PAGE_SIZE);
+
+	// Raw storage reusing a deleted allocation still holds its destroyed objects
+	LifetimeStruct *deleted = New<LifetimeStruct>(1, 1, std::string(64, 'x'));
+	ASSERT_EQ(Delete<LifetimeStruct>(deleted), 0);
+
+	LifetimeStruct *raw = PageRegistry<LifetimeStruct>::Alloc(1);
+	ASSERT_EQ(raw, deleted);
+
+	(void)New<LifetimeStruct>(2);
+	(void)Realloc<LifetimeStruct>(New<LifetimeStruct>(1), 3);
+	ASSERT_EQ(LifetimeStruct::destroyed, 1);
+
+	// Only the leaked New() allocations are destroyed
+	PageRegistry<LifetimeStruct>::Reset();
+	ASSERT_EQ(LifetimeStruct::destroyed, 1 + 2 + 3);
+}
+
+TEST(PoolTest, ConcurrentNewDeleteMatchLifetimes)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<LifetimeStruct>::Reset();
+	LifetimeStruct::constructed = 0;
+	LifetimeStruct::destroyed = 0;
+
+	PageRegistry<LifetimeStruct>::Initialize(DEFAULT_PAGE_SIZE, true);
+
+	// Counts that are not a power of two come from larger magazine spans
+	std::thread worker([]()
+	{
+		for (size_t count = 1; count <= 20; ++count)
+		{
+			LifetimeStruct *objects = New<LifetimeStruct>(count, 1, std::string("concurrent"));
+			(void)Delete<LifetimeStruct>(objects);
+		}
+
+		(void)New<LifetimeStruct>(5);
+	});
+	worker.join();
+
+	ASSERT_EQ(LifetimeStruct::constructed, 210 + 5);
+	ASSERT_EQ(LifetimeStruct::destroyed, 210);
+
+	// Reset destroys the leaked allocation and nothing else
+	PageRegistry<LifetimeStruct>::Reset();
+	ASSERT_EQ(LifetimeStruct::destroyed, LifetimeStruct::constructed);
+}
+
+TEST(PoolTest, GrowsByPages)
+{
+	using namespace MemoryInternal;
+
+	constexpr size_t growPageSize = 256;
+
+	PageRegistry<int>::Reset();
+	PageRegistry<int>::Initialize(growPageSize);
+
+	ASSERT_EQ(PageRegistry<int>::DBG_GetPageStorage().size(), growPageSize);
+
+	// Fill the first page completely
+	int *first = Alloc<int>(growPageSize);
+	ASSERT_TRUE(first != nullptr);
+	first[0] = 1;
+	first[growPageSize - 1] = 2;
+
+	// The next allocation has to add a page, without moving existing allocations
+	int *second = Alloc<int>(16);
+	ASSERT_TRUE(second != nullptr);
+	ASSERT_EQ(second, first + growPageSize);
+	ASSERT_EQ(PageRegistry<int>::DBG_GetPageStorage().size(), growPageSize * 2);
+	ASSERT_EQ(first[0], 1);
+	ASSERT_EQ(first[growPageSize - 1], 2);
+
+	// Allocations larger than a page add as many pages as needed
+	int *large = Alloc<int>(growPageSize * 3);
+	ASSERT_TRUE(large != nullptr);
+	ASSERT_EQ(PageRegistry<int>::GetAllocatedCount(large), growPageSize * 3);
+
+	ASSERT_EQ(Free<int>(first), 0);
+	ASSERT_EQ(Free<int>(second), 0);
+	ASSERT_EQ(Free<int>(large), 0);
+
+	// All pages coalesce into one region
+	auto regions = PageRegistry<int>::DBG_GetOrderedFreeRegions();
+	ASSERT_EQ(regions.size(), 1ULL);
+	ASSERT_EQ(regions[0].size, PageRegistry<int>::DBG_GetPageStorage().size());
+
+	PageRegistry<int>::Reset();
+}
+
+TEST(PoolTest, DecommitsIdleRegions)
+{
+	using namespace MemoryInternal;
+
+	constexpr size_t idleFrees = 8;
+
+	PageRegistry<double>::Reset();
+	PageRegistry<double>::Initialize(1ull << 16);
+	PageRegistry<double>::SetDecommitPolicy(1 << 12, idleFrees);
+
+	double *large = Alloc<double>(1ull << 15);
+	ASSERT_TRUE(large != nullptr);
+	std::fill_n(large, 1ull << 15, 1.0);
+
+	double *small = Alloc<double>(1);
+	ASSERT_EQ(Free<double>(large), 0);
+
+	// The freed region has not been idle long enough yet
+	ASSERT_EQ(PageRegistry<double>::ReleaseIdlePages(), 0ULL);
+	ASSERT_EQ(PageRegistry<double>::DBG_GetDecommittedBytes(), 0ULL);
+
+	// Churning elsewhere lets it age until the next sweep of the policy decommits it on its own
+	for (size_t i = 0; i < idleFrees * 2; ++i)
+	{
+		double *churn = Alloc<double>(1);
+		ASSERT_EQ(Free<double>(churn), 0);
+	}
+
+	size_t decommitted = PageRegistry<double>::DBG_GetDecommittedBytes();
+	ASSERT_GE(decommitted, (1ull << 15) * sizeof(double) - (1 << 13));
+
+	// Regions are only decommitted once
+	ASSERT_EQ(PageRegistry<double>::ReleaseIdlePages(), 0ULL);
+
+	// Merging the decommitted regions either side of a freed allocation only hands back the pages it touched
+	PageRegistry<double>::SetDecommitPolicy(1 << 12, 0);
+	PageRegistry<double>::ReleaseIdlePages();
+	ASSERT_EQ(Free<double>(small), 0);
+	ASSERT_LE(PageRegistry<double>::ReleaseIdlePages(), 2 * VirtualMemory::GetPageSize());
+	ASSERT_EQ(PageRegistry<double>::ReleaseIdlePages(), 0ULL);
+
+	// The memory stays usable afterwards
+	double *reused = Alloc<double>(1ull << 14);
+	ASSERT_TRUE(reused != nullptr);
+	std::fill_n(reused, 1ull << 14, 2.0);
+	ASSERT_EQ(reused[(1ull << 14) - 1], 2.0);
+
+	ASSERT_EQ(Free<double>(reused), 0);
+
+	PageRegistry<double>::SetDecommitPolicy(DEFAULT_DECOMMIT_MIN_BYTES, DEFAULT_DECOMMIT_IDLE_FREES);
+	PageRegistry<double>::Reset();
+}
+
+TEST(PoolTest, CompactAllocMetadata)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<float>::Reset();
+	PageRegistry<float>::Initialize(1ull << 16);
+
+	// Back to back allocations sharing and crossing bitmap words keep their own sizes
+	std::vector<float *> allocs;
+	for (size_t count : { 1, 1, 63, 64, 65, 2, 130, 1 })
+	{
+		allocs.push_back(Alloc<float>(count));
+		ASSERT_EQ(PageRegistry<float>::GetAllocatedCount(allocs.back()), count);
+	}
+
+	ASSERT_EQ(GetAllocatedSize<float>(allocs[4] + 64), 65ULL);
+	ASSERT_EQ(PageRegistry<float>::GetAllocatedCount(allocs[4] + 1), 0ULL);
+
+	ASSERT_EQ(Free<float>(allocs[3]), 0);
+	ASSERT_EQ(PageRegistry<float>::GetAllocatedCount(allocs[3]), 0ULL);
+	ASSERT_EQ(PageRegistry<float>::GetAllocatedCount(allocs[4]), 65ULL);
+	ASSERT_EQ(PageRegistry<float>::GetAllocatedCount(allocs[2]), 63ULL);
+
+	for (size_t i = 0; i < allocs.size(); ++i)
+	{
+		if (i != 3)
+		{
+			ASSERT_EQ(Free<float>(allocs[i]), 0);
+		}
+	}
+
+	// Nothing per element, only the counts of the live allocations and the free region bookkeeping
+	size_t storageBytes = PageRegistry<float>::GetCommittedBytes();
+	ASSERT_LE(PageRegistry<float>::GetMetadataBytes(), storageBytes / 16);
+
+	PageRegistry<float>::Reset();
+}
+
+TEST(PoolTest, SizeClassSkipsSmallRegions)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<int>::Reset();
+
+	int *allocA = Alloc<int>(8);
+	int *allocB = Alloc<int>(64);
+	int *allocC = Alloc<int>(8);
+	int *allocD = Alloc<int>(64);
+
+	ASSERT_EQ(Free<int>(allocA), 0);
+	ASSERT_EQ(Free<int>(allocC), 0);
+
+	// Neither hole can hold the request, so it must be placed after the last allocation
+	int *allocE = Alloc<int>(40);
+	ASSERT_TRUE(allocE != nullptr);
+	ASSERT_TRUE(allocE >= allocD + 64);
+
+	// The holes are still usable by requests that fit them
+	int *allocF = Alloc<int>(8);
+	ASSERT_TRUE(allocF == allocA || allocF == allocC);
+
+	ASSERT_EQ(Free<int>(allocB), 0);
+	ASSERT_EQ(Free<int>(allocD), 0);
+	ASSERT_EQ(Free<int>(allocE), 0);
+	ASSERT_EQ(Free<int>(allocF), 0);
+
+	// Everything should have coalesced back into a single region
+	const auto &freeRegions = PageRegistry<int>::DBG_GetFreeRegions();
+	size_t root = PageRegistry<int>::DBG_GetFreeRegionRoot();
+
+	ASSERT_EQ(freeRegions[root].offset, 0ULL);
+	ASSERT_EQ(freeRegions[root].size, DEFAULT_PAGE_SIZE);
+	ASSERT_EQ(freeRegions[root].left, NULL_INDEX);
+	ASSERT_EQ(freeRegions[root].right, NULL_INDEX);
+}
+
+TEST(PoolTest, FreeLinksAreRecycled)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<int>::Reset();
+
+	int *allocs[16]{};
+
+	for (int i = 0; i < 16; ++i)
+		allocs[i] = Alloc<int>(1);
+
+	// Every other free is isolated and needs a link of its own
+	for (int i = 0; i < 16; i += 2)
+		ASSERT_EQ(Free<int>(allocs[i]), 0);
+
+	size_t linkCount = PageRegistry<int>::DBG_GetFreeRegions().size();
+
+	// Churning the same holes must reuse released links instead of growing the storage
+	for (int iter = 0; iter < 100; ++iter)
+	{
+		for (int i = 0; i < 16; i += 2)
+			allocs[i] = Alloc<int>(1);
+
+		for (int i = 0; i < 16; i += 2)
+			ASSERT_EQ(Free<int>(allocs[i]), 0);
+	}
+
+	ASSERT_EQ(PageRegistry<int>::DBG_GetFreeRegions().size(), linkCount);
+
+	for (int i = 1; i < 16; i += 2)
+		ASSERT_EQ(Free<int>(allocs[i]), 0);
+}
+
+TEST(PoolTest, FreeRegionTreeStaysBalanced)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<int>::Reset();
+
+	std::vector<int *> allocs;
+	allocs.resize(2048, nullptr);
+
+	for (size_t i = 0; i < allocs.size(); ++i)
+		allocs[i] = Alloc<int>(1);
+
+	// Freeing in ascending address order is the worst case for an unbalanced tree
+	for (size_t i = 0; i < allocs.size(); i += 2)
+		ASSERT_EQ(Free<int>(allocs[i]), 0);
+
+	const auto &freeRegions = PageRegistry<int>::DBG_GetFreeRegions();
+	size_t root = PageRegistry<int>::DBG_GetFreeRegionRoot();
+
+	// 1025 regions, an AVL tree of that size is at most 14 levels deep
+	ASSERT_EQ(PageRegistry<int>::DBG_GetOrderedFreeRegions().size(), 1025ULL);
+	ASSERT_LE(freeRegions[root].height, 14ULL);
+
+	for (size_t i = 1; i < allocs.size(); i += 2)
+		ASSERT_EQ(Free<int>(allocs[i]), 0);
+
+	ASSERT_EQ(PageRegistry<int>::DBG_GetOrderedFreeRegions().size(), 1ULL);
+}
+
+TEST(PoolTest, FreeRegionsStayOrderedAndCoalesced)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<int>::Reset();
+
+	std::vector<int *> allocs;
+	std::vector<size_t> sizes;
+
+	for (int iter = 0; iter < 2000; ++iter)
+	{
+		if (!allocs.empty() && (rand() % 2 == 0))
+		{
+			size_t idx = rand() % allocs.size();
+			ASSERT_EQ(Free<int>(allocs[idx]), 0);
+
+			allocs.erase(allocs.begin() + idx);
+			sizes.erase(sizes.begin() + idx);
+		}
+		else
+		{
+			size_t size = (rand() % 64) + 1;
+			int *alloc = Alloc<int>(size);
+
+			if (alloc != nullptr)
+			{
+				allocs.push_back(alloc);
+				sizes.push_back(size);
+			}
+		}
+
+		// Regions must be sorted, disjoint and never directly adjacent
+		auto regions = PageRegistry<int>::DBG_GetOrderedFreeRegions();
+		size_t totalFree = 0;
+
+		for (size_t i = 0; i < regions.size(); ++i)
+		{
+			totalFree += regions[i].size;
+
+			if (i > 0)
+			{
+				ASSERT_LT(regions[i - 1].offset + regions[i - 1].size, regions[i].offset);
+			}
+		}
+
+		size_t totalAllocated = 0;
+		for (size_t size : sizes)
+			totalAllocated += size;
+
+		ASSERT_EQ(totalFree + totalAllocated, DEFAULT_PAGE_SIZE);
+	}
+
+	for (int *alloc : allocs)
+		ASSERT_EQ(Free<int>(alloc), 0);
+
+	ASSERT_EQ(PageRegistry<int>::DBG_GetOrderedFreeRegions().size(), 1ULL);
+}
+
+TEST(PoolTest, ConcurrentAllocFree)
+{
+	using namespace MemoryInternal;
+
+	PageRegistry<double>::Reset();
+	PageRegistry<double>::Initialize(1ull << 16, true);
+
+	constexpr int threadCount = 4;
+	std::atomic<int> failures = 0;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([t, &failures]()
+		{
+			std::minstd_rand rng(t + 1);
+			std::vector<std::pair<double *, size_t>> live;
+
+			for (int iter = 0; iter < 5000; ++iter)
+			{
+				if (!live.empty() && (rng() % 2 == 0))
+				{
+					size_t idx = rng() % live.size();
+					auto [ptr, size] = live[idx];
+
+					// Another thread writing into this span would have changed the pattern
+					for (size_t k = 0; k < size; ++k)
+					{
+						if (ptr[k] != static_cast<double>(t))
+							++failures;
+					}
+
+					if (Free<double>(ptr) != 0)
+						++failures;
+
+					live.erase(live.begin() + idx);
+				}
+				else
+				{
+					size_t size = (rng() % 300) + 1;
+					double *ptr = Alloc<double>(size);
+
+					if (ptr == nullptr)
+						continue;
+
+					// Magazine spans are rounded up internally only
+					if (PageRegistry<double>::GetAllocatedCount(ptr) != size)
+						++failures;
+
+					for (size_t k = 0; k < size; ++k)
+						ptr[k] = static_cast<double>(t);
+
+					live.emplace_back(ptr, size);
+				}
+			}
+
+			for (auto [ptr, size] : live)
+			{
+				if (Free<double>(ptr) != 0)
+					++failures;
+			}
+
+			// Padding behind a rounded up span is released by Resize and FreeBatch as well
+			double *padded[2] = { Alloc<double>(3), Alloc<double>(5) };
+			if (PageRegistry<double>::Resize(padded[0], 4) != 0 || PageRegistry<double>::GetAllocatedCount(padded[0]) != 4)
+				++failures;
+			if (PageRegistry<double>::FreeBatch(padded, 2) != 2)
+				++failures;
+
+			// Same-thread reuse comes straight back out of the magazine
+			double *first = Alloc<double>(4);
+			Free<double>(first);
+			if (Alloc<double>(4) != first)
+				++failures;
+			Free<double>(first);
+		});
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+
+	ASSERT_EQ(failures.load(), 0);
+
+	// Exiting threads flush their caches, so everything is back in one region.
+	// Depending on how the threads interleave the storage may have grown past the first page.
+	auto regions = PageRegistry<double>::DBG_GetOrderedFreeRegions();
+	ASSERT_EQ(regions.size(), 1ULL);
+	ASSERT_EQ(regions[0].size, PageRegistry<double>::DBG_GetPageStorage().size());
+
+	PageRegistry<double>::Reset();
+}
+
 
 constexpr int allocCount = 10000;
 constexpr int maxConcurrentAllocs = 8;
@@ -0,0 +1,136 @@
+#include "../../../Application/inc/SlabAllocator.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstring>
+
+using Slabs = SlabAllocator<BuddyAllocator>;
+
+
+// Tests
+
+TEST(SlabTest, SizeClasses)
+{
+	ASSERT_EQ(Slabs::ClassSize(0), 16ULL);
+	ASSERT_EQ(Slabs::ClassSize(Slabs::NUM_CLASSES - 1), Slabs::MAX_SMALL_SIZE);
+
+	for (size_t size = 1; size <= Slabs::MAX_SMALL_SIZE; ++size)
+	{
+		size_t classIndex = Slabs::ClassIndex(size);
+		size_t classSize = Slabs::ClassSize(classIndex);
+
+		// Smallest class that fits
+		ASSERT_LT(classIndex, Slabs::NUM_CLASSES);
+		ASSERT_GE(classSize, size);
+		if (classIndex > 0)
+		{
+			ASSERT_LT(Slabs::ClassSize(classIndex - 1), size);
+		}
+
+		// Above 128 bytes rounding wastes less than 1/8 of the slot
+		if (size > 128)
+		{
+			ASSERT_LT((classSize - size) * 8, classSize);
+		}
+	}
+}
+
+TEST(SlabTest, AllocFree)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+	auto slabs = std::make_unique<Slabs>(*buddy);
+
+	// Small objects of one class are packed into the same slab
+	std::vector<char *> objects;
+	for (int i = 0; i < 100; ++i)
+	{
+		char *object = (char *)slabs->Alloc(24);
+		ASSERT_TRUE(object != nullptr);
+		memset(object, i, 24);
+
+		for (char *other : objects)
+			ASSERT_TRUE(object + 32 <= other || other + 32 <= object);
+
+		objects.push_back(object);
+	}
+
+	ASSERT_EQ(slabs->GetSlabCount(), 1ULL);
+	ASSERT_EQ(buddy->GetFreeBytes(), BuddyAllocator::GetArenaSize() - slabs->GetSlabBytes());
+
+	// A freed slot is handed out again
+	slabs->Free(objects[40]);
+	ASSERT_EQ(slabs->Alloc(30), objects[40]);
+
+	// Large requests go straight to the buddy
+	size_t freeBytes = buddy->GetFreeBytes();
+	void *large = slabs->Alloc(Slabs::MAX_SMALL_SIZE + 1);
+	ASSERT_TRUE(large != nullptr);
+	ASSERT_EQ(slabs->GetSlabCount(), 1ULL);
+	ASSERT_EQ(buddy->GetFreeBytes(), freeBytes - 32 * 1024);
+
+	slabs->Free(large);
+	ASSERT_EQ(buddy->GetFreeBytes(), freeBytes);
+
+	ASSERT_EQ(slabs->Alloc(0), nullptr);
+}
+
+TEST(SlabTest, InvalidFrees)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+	auto slabs = std::make_unique<Slabs>(*buddy);
+
+	char *first = (char *)slabs->Alloc(100);
+	char *second = (char *)slabs->Alloc(100);
+
+	// Pointers inside a slot and double frees are ignored
+	slabs->Free(nullptr);
+	slabs->Free(first + 1);
+	slabs->Free(second);
+	slabs->Free(second);
+
+	ASSERT_EQ(slabs->Alloc(100), second);
+	ASSERT_NE(slabs->Alloc(100), first);
+
+	// 112 byte slots leave a tail behind the last one, which is never handed out even when freed
+	char *tail = first + (64 * 1024 / 112) * 112;
+	slabs->Free(tail);
+
+	while (slabs->GetSlabCount() == 1)
+		ASSERT_NE(slabs->Alloc(100), tail);
+}
+
+TEST(SlabTest, EmptySlabsReturnToBuddy)
+{
+	auto buddy = std::make_unique<BuddyAllocator>();
+	size_t arenaSize = buddy->GetFreeBytes();
+
+	{
+		auto slabs = std::make_unique<Slabs>(*buddy);
+
+		std::mt19937 rng(42);
+		std::vector<void *> objects;
+
+		// Several slabs of a few different classes
+		for (int i = 0; i < 5000; ++i)
+		{
+			objects.push_back(slabs->Alloc(1 + rng() % 512));
+			ASSERT_TRUE(objects.back() != nullptr);
+		}
+
+		size_t slabCount = slabs->GetSlabCount();
+		ASSERT_GT(slabCount, 10ULL);
+
+		std::shuffle(objects.begin(), objects.end(), rng);
+		for (void *object : objects)
+			slabs->Free(object);
+
+		// One empty slab is kept per class that was used
+		ASSERT_LT(slabs->GetSlabCount(), slabCount);
+		ASSERT_LE(slabs->GetSlabCount(), 512ULL / 16);
+		ASSERT_EQ(buddy->GetFreeBytes(), arenaSize - slabs->GetSlabBytes());
+	}
+
+	ASSERT_EQ(buddy->GetFreeBytes(), arenaSize);
+	ASSERT_TRUE(buddy->Alloc(arenaSize) != nullptr);
+}
@@ -1,6 +1,12 @@
 #include "../../../Application/inc/StackAllocator.hpp"
+#include "../../../Application/inc/DoubleEndedStackAllocator.hpp"
+#include "../../../Application/inc/DoubleBufferedAllocator.hpp"
+#include "../../../Application/inc/ChainedStackAllocator.hpp"
 #include <gtest/gtest.h>
 #include <vector>
+#include <cstring>
+#include <cstddef>
+#include <array>
 
 TEST(StackTest, InitiallyEmpty)
 {
@@ -34,6 +40,8 @@ TEST(StackTest, PushData)
     size_t expectedSize = sizeof(intA) + sizeof(intB) + sizeof(intC) +
         sizeof(strA) + sizeof(strB) + sizeof(strC) + sizeof(strD);
 
+    // Raw pushes are packed
+    ASSERT_EQ(stackAllocator.DBG_GetPaddingBytes(), 0ULL);
     ASSERT_EQ(stackAllocator.DBG_GetTop(), expectedSize);
 }
 
@@ -75,10 +83,10 @@ TEST(StackTest, RetrieveData)
         std::string strC = "CCCCCCCC";
         std::string strD = "DDDDDDDD";
 
-        strPtrs.push_back(stackAllocator.Push(&strA, sizeof(strA)));
-        strPtrs.push_back(stackAllocator.Push(&strB, sizeof(strB)));
-        strPtrs.push_back(stackAllocator.Push(&strC, sizeof(strC)));
-        strPtrs.push_back(stackAllocator.Push(&strD, sizeof(strD)));
+        strPtrs.push_back(stackAllocator.Push(&strA, sizeof(strA), alignof(std::string)));
+        strPtrs.push_back(stackAllocator.Push(&strB, sizeof(strB), alignof(std::string)));
+        strPtrs.push_back(stackAllocator.Push(&strC, sizeof(strC), alignof(std::string)));
+        strPtrs.push_back(stackAllocator.Push(&strD, sizeof(strD), alignof(std::string)));
     }
 
     int* intA = (int*)stackAllocator.At(intPtrs[0]);
@@ -119,18 +127,314 @@ TEST(StackTest, NoOverflow)
     char e = 'e';
     char f = 'f';
 
-    stackAllocator.Push(&a, sizeof(a));
-    stackAllocator.Push(&b, sizeof(b));
-    stackAllocator.Push(&c, sizeof(c));
-    stackAllocator.Push(&d, sizeof(d));
+    stackAllocator.Push(&a, sizeof(a), alignof(char));
+    stackAllocator.Push(&b, sizeof(b), alignof(char));
+    stackAllocator.Push(&c, sizeof(c), alignof(char));
+    stackAllocator.Push(&d, sizeof(d), alignof(char));
     
     ASSERT_NE(stackAllocator.DBG_GetTop(), (size_t)-1);
     
-    stackAllocator.Push(&e, sizeof(e));
+    stackAllocator.Push(&e, sizeof(e), alignof(char));
     
     ASSERT_EQ(stackAllocator.DBG_GetTop(), stackAllocator.DBG_GetMaxSize());
 
-    size_t ptr = stackAllocator.Push(&f, sizeof(f));
+    size_t ptr = stackAllocator.Push(&f, sizeof(f), alignof(char));
 
     ASSERT_EQ(ptr, (size_t)-1);
 }
+
+TEST(StackTest, PushLargeBlock)
+{
+    StackAllocator stackAllocator;
+
+    std::vector<char> data(stackAllocator.DBG_GetMaxSize() / 2);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (char)(i * 7);
+
+    char c = 'c';
+    stackAllocator.Push(&c, sizeof(c));
+
+    size_t ptr = stackAllocator.Push(data.data(), data.size());
+
+    ASSERT_EQ(ptr, sizeof(c));
+    ASSERT_EQ(memcmp(stackAllocator.At(ptr), data.data(), data.size()), 0);
+
+    // Too large to fit in what is left
+    ASSERT_EQ(stackAllocator.Push(data.data(), data.size()), (size_t)-1);
+    ASSERT_EQ(stackAllocator.DBG_GetTop(), ptr + data.size());
+}
+
+TEST(StackTest, AllocateAligned)
+{
+    StackAllocator stackAllocator;
+
+    char c = 'c';
+    stackAllocator.Push(&c, sizeof(c));
+
+    void* mem = stackAllocator.Allocate(100, 64);
+
+    ASSERT_TRUE(mem != nullptr);
+    ASSERT_EQ((uintptr_t)mem % 64, 0ULL);
+    ASSERT_GE(stackAllocator.DBG_GetTop(), 101ULL);
+    ASSERT_EQ((char*)mem + 100, (char*)stackAllocator.DBG_GetStack().get()->data() + stackAllocator.DBG_GetTop());
+
+    ASSERT_EQ(stackAllocator.Allocate(stackAllocator.DBG_GetMaxSize()), nullptr);
+    ASSERT_TRUE(stackAllocator.Allocate(stackAllocator.DBG_GetMaxSize() - stackAllocator.DBG_GetTop(), 1) != nullptr);
+    ASSERT_EQ(stackAllocator.DBG_GetTop(), stackAllocator.DBG_GetMaxSize());
+}
+
+TEST(StackTest, EmplaceConstructsInPlace)
+{
+    struct alignas(16) Vec
+    {
+        float x, y, z;
+
+        Vec(float x, float y, float z) : x(x), y(y), z(z) {}
+    };
+
+    StackAllocator stackAllocator;
+
+    char c = 'c';
+    stackAllocator.Push(&c, sizeof(c));
+
+    Vec* vec = stackAllocator.Emplace<Vec>(1.0f, 2.0f, 3.0f);
+
+    ASSERT_TRUE(vec != nullptr);
+    ASSERT_EQ((uintptr_t)vec % alignof(Vec), 0ULL);
+    ASSERT_EQ(vec->x, 1.0f);
+    ASSERT_EQ(vec->y, 2.0f);
+    ASSERT_EQ(vec->z, 3.0f);
+
+    int* value = stackAllocator.Emplace<int>(42);
+    ASSERT_EQ(*value, 42);
+    ASSERT_EQ((char*)value, (char*)(vec + 1));
+}
+
+TEST(StackTest, PushesAreAligned)
+{
+    StackAllocator stackAllocator;
+
+    // The base itself is aligned to a cache line
+    ASSERT_EQ((uintptr_t)stackAllocator.DBG_GetStack().get()->data() % 64, 0ULL);
+
+    char c = 'c';
+    double d = 2.0;
+    std::array<float, 16> simd = {};
+
+    size_t charPtr = stackAllocator.Push(&c, sizeof(c), alignof(char));
+    size_t doublePtr = stackAllocator.Push(&d, sizeof(d), alignof(double));
+    size_t simdPtr = stackAllocator.Push(&simd, sizeof(simd), 64);
+
+    ASSERT_EQ(charPtr, 0ULL);
+    ASSERT_EQ(doublePtr, alignof(double));
+    ASSERT_EQ(simdPtr, 64ULL);
+    ASSERT_EQ((uintptr_t)stackAllocator.At(simdPtr) % 64, 0ULL);
+    ASSERT_EQ(*(double*)stackAllocator.At(doublePtr), 2.0);
+
+    ASSERT_EQ(stackAllocator.DBG_GetPaddingBytes(), (alignof(double) - 1) + (64 - alignof(double) - sizeof(double)));
+
+    // Reset starts counting padding over
+    stackAllocator.Reset();
+    ASSERT_EQ(stackAllocator.DBG_GetPaddingBytes(), 0ULL);
+
+    // Typed pushes only pad up to the alignment of their own type
+    charPtr = stackAllocator.Push(c);
+    size_t intPtr = stackAllocator.Push(7);
+    doublePtr = stackAllocator.Push(d);
+
+    ASSERT_EQ(charPtr, 0ULL);
+    ASSERT_EQ(intPtr, alignof(int));
+    ASSERT_EQ(doublePtr, alignof(double));
+    ASSERT_EQ(*(int*)stackAllocator.At(intPtr), 7);
+    ASSERT_EQ(*(double*)stackAllocator.At(doublePtr), 2.0);
+    ASSERT_EQ(stackAllocator.DBG_GetPaddingBytes(), alignof(int) - sizeof(c));
+}
+
+TEST(StackTest, FreeToMarker)
+{
+    StackAllocator stackAllocator;
+
+    int a = 1;
+    int b = 2;
+
+    size_t ptrA = stackAllocator.Push(&a, sizeof(a));
+    size_t marker = stackAllocator.GetMarker();
+
+    stackAllocator.Push(&b, sizeof(b));
+    stackAllocator.Push(&b, sizeof(b));
+
+    stackAllocator.FreeToMarker(marker);
+
+    ASSERT_EQ(stackAllocator.DBG_GetTop(), marker);
+    ASSERT_EQ(*(int*)stackAllocator.At(ptrA), 1);
+
+    // Memory released to the marker is handed out again
+    ASSERT_EQ(stackAllocator.Push(&b, sizeof(b)), marker);
+
+    // Markers above the top are stale and ignored
+    size_t top = stackAllocator.DBG_GetTop();
+    stackAllocator.FreeToMarker(top + 100);
+    ASSERT_EQ(stackAllocator.DBG_GetTop(), top);
+}
+
+TEST(StackTest, NestedScopes)
+{
+    StackAllocator stackAllocator;
+    std::array<char, 1000> scratch = {};
+
+    stackAllocator.Push(&scratch, sizeof(scratch));
+    size_t frameTop = stackAllocator.DBG_GetTop();
+
+    {
+        ScopedStack outer(stackAllocator);
+        stackAllocator.Push(&scratch, sizeof(scratch));
+
+        {
+            ScopedStack inner(stackAllocator);
+            stackAllocator.Push(&scratch, sizeof(scratch));
+        }
+
+        ASSERT_LT(stackAllocator.DBG_GetTop(), frameTop + 2 * sizeof(scratch));
+        ASSERT_GT(stackAllocator.DBG_GetTop(), frameTop);
+    }
+
+    ASSERT_EQ(stackAllocator.DBG_GetTop(), frameTop);
+
+    // Scopes that run one after the other reuse the same memory, so the peak is the largest of them
+    for (int i = 0; i < 4; i++)
+    {
+        ScopedStack scope(stackAllocator);
+        stackAllocator.Push(&scratch, sizeof(scratch));
+    }
+
+    ASSERT_LT(stackAllocator.DBG_GetPeakTop(), frameTop + 3 * sizeof(scratch));
+}
+
+TEST(StackTest, DoubleEndedStack)
+{
+    DoubleEndedStackAllocator stackAllocator;
+
+    // Level data from the bottom, transient data from the top
+    double* level = stackAllocator.EmplaceBottom<double>(1.5);
+    char* transient = (char*)stackAllocator.AllocateTop(100, 64);
+
+    ASSERT_TRUE(level != nullptr && transient != nullptr);
+    ASSERT_EQ(*level, 1.5);
+    ASSERT_EQ((uintptr_t)transient % 64, 0ULL);
+    ASSERT_EQ(stackAllocator.DBG_GetBottom(), sizeof(double));
+    ASSERT_GE(stackAllocator.DBG_GetTop(), stackAllocator.DBG_GetMaxSize() - 100 - 64);
+
+    // Either side can use all the space the other leaves
+    size_t marker = stackAllocator.GetTopMarker();
+    void* rest = stackAllocator.AllocateTop(stackAllocator.DBG_GetTop() - stackAllocator.DBG_GetBottom(), 1);
+
+    ASSERT_TRUE(rest != nullptr);
+    ASSERT_EQ(stackAllocator.AllocateBottom(1, 1), nullptr);
+    ASSERT_EQ(stackAllocator.AllocateTop(1, 1), nullptr);
+
+    stackAllocator.FreeTopToMarker(marker);
+    ASSERT_TRUE(stackAllocator.AllocateBottom(1000) != nullptr);
+
+    // Clearing the transient side keeps the level data
+    stackAllocator.ResetTop();
+    ASSERT_EQ(stackAllocator.DBG_GetTop(), stackAllocator.DBG_GetMaxSize());
+    ASSERT_EQ(*level, 1.5);
+}
+
+TEST(StackTest, DoubleBufferedSurvivesOneFrame)
+{
+    DoubleBufferedAllocator frameAllocator;
+
+    // Frame N
+    int* readback = frameAllocator.Emplace<int>(7);
+    ASSERT_TRUE(readback != nullptr);
+
+    // Frame N + 1 allocates from the other buffer, frame N's data is untouched
+    frameAllocator.SwapBuffers();
+    int* next = frameAllocator.Emplace<int>(8);
+
+    ASSERT_NE(next, readback);
+    ASSERT_EQ(*readback, 7);
+    ASSERT_EQ(frameAllocator.GetPreviousBuffer().DBG_GetTop(), sizeof(int));
+
+    // Frame N + 2 reuses frame N's buffer
+    frameAllocator.SwapBuffers();
+    ASSERT_EQ(frameAllocator.GetCurrentBuffer().DBG_GetTop(), 0ULL);
+    ASSERT_EQ(frameAllocator.Emplace<int>(9), readback);
+    ASSERT_EQ(*next, 8);
+}
+
+TEST(StackTest, ChainedGrowsOnOverflow)
+{
+    ChainedStackAllocator stackAllocator(1024);
+
+    // Far more than one chunk holds, all of it stays intact
+    std::vector<int*> values;
+    for (int i = 0; i < 1000; i++)
+    {
+        values.push_back(stackAllocator.Push(i));
+        ASSERT_TRUE(values.back() != nullptr);
+        ASSERT_EQ((uintptr_t)values.back() % alignof(int), 0ULL);
+    }
+
+    for (int i = 0; i < 1000; i++)
+        ASSERT_EQ(*values[i], i);
+
+    ASSERT_GT(stackAllocator.GetChunkCount(), 1ULL);
+
+    // Allocations larger than a chunk get a chunk of their own
+    void* large = stackAllocator.Allocate(5000, 256);
+    ASSERT_TRUE(large != nullptr);
+    ASSERT_EQ((uintptr_t)large % 256, 0ULL);
+}
+
+TEST(StackTest, ChainedResetKeepsPeakSizedChunk)
+{
+    ChainedStackAllocator stackAllocator(1024, 2);
+    std::array<char, 100> data = {};
+
+    for (int i = 0; i < 50; i++)
+        stackAllocator.Push(&data, sizeof(data));
+
+    size_t frameBytes = stackAllocator.GetFrameBytes();
+    ASSERT_GE(frameBytes, 50 * sizeof(data));
+    ASSERT_GT(stackAllocator.GetChunkCount(), 1ULL);
+
+    stackAllocator.Reset();
+
+    // One chunk large enough for the last frame, the rest pooled up to the limit
+    ASSERT_EQ(stackAllocator.GetLastFramePeak(), frameBytes);
+    ASSERT_EQ(stackAllocator.GetFrameBytes(), 0ULL);
+    ASSERT_EQ(stackAllocator.GetChunkCount(), 1ULL);
+    ASSERT_LE(stackAllocator.GetPooledChunkCount(), 2ULL);
+
+    // The same frame again fits without chaining
+    for (int i = 0; i < 50; i++)
+        stackAllocator.Push(&data, sizeof(data));
+
+    ASSERT_EQ(stackAllocator.GetChunkCount(), 1ULL);
+
+    size_t reservedBytes = stackAllocator.GetReservedBytes();
+    stackAllocator.Reset();
+    ASSERT_EQ(stackAllocator.GetReservedBytes(), reservedBytes);
+}
+
+TEST(StackTest, ChainedResetReleasesSpikeChunks)
+{
+    ChainedStackAllocator stackAllocator(1024);
+    std::array<char, 100> data = {};
+
+    size_t idleBytes = stackAllocator.GetReservedBytes();
+
+    // One frame far larger than the usual ones
+    ASSERT_TRUE(stackAllocator.Allocate(64 * 1024) != nullptr);
+    stackAllocator.Reset();
+    ASSERT_GE(stackAllocator.GetReservedBytes(), 64ULL * 1024);
+
+    // A small frame afterwards drops back to a single small chunk
+    stackAllocator.Push(&data, sizeof(data));
+    stackAllocator.Reset();
+
+    ASSERT_EQ(stackAllocator.GetChunkCount(), 1ULL);
+    ASSERT_EQ(stackAllocator.GetReservedBytes(), idleBytes);
+}